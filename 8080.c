@@ -2,9 +2,18 @@
 
 //#include <sys/types.h>
 #include <stdio.h> // printf
-#include <stdlib.h> // exit()
+#include <string.h> // memcpy
+#include <stddef.h> // offsetof
 
 #include "8080.h"
+#include "flight.h"
+#include "ops.h"
+
+_Static_assert(offsetof(struct i8080, flags) == offsetof(struct flight_record, flags)
+            && offsetof(struct i8080, sp) == offsetof(struct flight_record, sp)
+            && offsetof(struct i8080, pc) == offsetof(struct flight_record, pc)
+            && offsetof(struct flight_record, op) == 12,
+               "struct i8080 registers must match struct flight_record");
 
 // get register pair
 inline uint16_t rpBC(struct i8080* cpu) { return cpu->B << 8 | cpu->C; };
@@ -23,10 +32,14 @@ void setFlag(struct i8080 *cpu, const uint8_t flag, const uint8_t val) {
 	cpu->flags |= (1 << flag) * val; // set
 }
 
+// halts the CPU, it's up to the frontend to notice and decide what to do.
+// pc has already moved past the opcode.
 void unimplemented(struct i8080 *cpu, uint8_t *memory) {
-	printf("Unimplemented instruction, pc=%02x, mem[pc]=%02x\n", cpu->pc, memory[cpu->pc]);
+	const uint16_t pc = cpu->pc - 1;
+	printf("Unimplemented instruction, pc=%02x, mem[pc]=%02x\n", pc, memory[pc]);
+	fflush(stdout);
 	setFlag(cpu, HLT, 1);
-	exit(1);
+	if(cpu->recorder) flight_crash(cpu->recorder);
 }
 
 uint8_t parity(uint8_t val) {
@@ -40,11 +53,79 @@ uint8_t parity(uint8_t val) {
 	      ^ (val>>7)) & 1;
 }
 
+// from the opcode table. Conditional calls and returns take taken[op]
+// cycles instead of cycles[op] when they go.
+static const uint8_t length[256] = {
+#define X(op, fmt, len, ...) [op] = len,
+	OPCODES(X)
+#undef X
+};
+static const uint8_t cycles[256] = {
+#define X(op, fmt, len, cyc, ...) [op] = cyc,
+	OPCODES(X)
+#undef X
+};
+static const uint8_t taken[256] = {
+#define X(op, fmt, len, cyc, tak, ...) [op] = tak,
+	OPCODES(X)
+#undef X
+};
+
+_Static_assert(F_Z == 1 << Z && F_S == 1 << S && F_P == 1 << P && F_CY == 1 << CY && F_AC == 1 << AC,
+               "ops.h flags must be in the bits of enum flag");
+
+// Guest memory is mapped twice back to back (see mem.h), so a 16 bit access
+// at 0xFFFF reads 0xFFFF and 0x0000 without any masking. The 8080 is little
+// endian and so are the hosts we care about, these are single host loads.
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "rd16/wr16 assume a little endian host"
+#endif
+static inline uint16_t rd16(const uint8_t *p) { uint16_t v; memcpy(&v, p, 2); return v; }
+static inline void wr16(uint8_t *p, uint16_t v) { memcpy(p, &v, 2); }
+
+static inline uint8_t in(const struct ports *ports, uint8_t port) {
+	if(ports == NULL) return 0;
+	if(ports->in[port]) return ports->in[port](ports->ctx, port);
+	return ports->value[port];
+}
+static inline void out(const struct ports *ports, uint8_t port, uint8_t data) {
+	if(ports && ports->out[port]) ports->out[port](ports->ctx, port, data);
+}
+
+// all guest writes go through these two so that cpu->dirty and cpu->watch
+// stay correct
+static inline void store8(struct i8080 *cpu, uint8_t *memory, uint16_t addr, uint8_t v) {
+	memory[addr] = v;
+	if(cpu->dirty) cpu->dirty[addr >> DIRTY_SHIFT] = 1;
+	if(cpu->watch && cpu->watch->map[addr >> DIRTY_SHIFT]) cpu->watch->written(cpu->watch, addr, 1);
+}
+static inline void store16(struct i8080 *cpu, uint8_t *memory, uint16_t addr, uint16_t v) {
+	wr16(memory + addr, v);
+	const uint16_t next = addr + 1;
+	if(cpu->dirty) {
+		cpu->dirty[addr >> DIRTY_SHIFT] = 1;
+		cpu->dirty[next >> DIRTY_SHIFT] = 1;
+	}
+	if(cpu->watch && (cpu->watch->map[addr >> DIRTY_SHIFT] || cpu->watch->map[next >> DIRTY_SHIFT])) {
+		cpu->watch->written(cpu->watch, addr, 2);
+	}
+}
+
+void memory_written(struct i8080 *cpu, uint16_t addr, uint32_t len) {
+	if(len == 0) return;
+	const uint32_t last = (addr + len - 1) >> DIRTY_SHIFT;
+	int watched = 0;
+	for(uint32_t b = addr >> DIRTY_SHIFT;b <= last;b ++) {
+		if(cpu->dirty) cpu->dirty[b % DIRTY_SIZE] = 1;
+		if(cpu->watch) watched |= cpu->watch->map[b % DIRTY_SIZE];
+	}
+	if(watched) cpu->watch->written(cpu->watch, addr, len);
+}
+
 // RST 0 means "jump to 0x0", RST 1 means "vector to 0x8" and so on
 #define RST(n) { \
-		memory[cpu->sp-1] = (cpu->pc & 0xFF00) >> 8; \
-		memory[cpu->sp-2] = (cpu->pc & 0x00FF); \
 		cpu->sp -= 2; \
+		store16(cpu, memory, cpu->sp, cpu->pc); \
 		cpu->pc = n*8; \
 	}
 
@@ -54,16 +135,25 @@ void request_interrupt(struct i8080 *cpu, uint8_t *memory, uint8_t RST_n) {
 	if(!getFlag(cpu, EI)) return;
 
 	//printf("LETS GOO\n");
-	// disable interrupts
+	// disable interrupts, an interrupt also wakes up a halted CPU
 	setFlag(cpu, EI, 0);
+	setFlag(cpu, HLT, 0);
 
 	RST(RST_n);
+	cpu->clock_cnt += 11;
 }
 
-void execute_instruction(struct i8080 *cpu, uint8_t *memory, void (*out)(uint8_t,uint8_t)) {
-	// TODO many instructions do not set AC flag at all
+// The interpreter. live says which flags have to be computed, the others
+// may be left as they were because nobody reads them before they are set
+// again (see block.h). With lazy set, the result that Z, S and P come from
+// is kept in cpu->lazy so that they can be worked out later instead.
+// Every caller passes constants, so each one gets its own copy with the
+// dead flag work compiled out.
+static inline __attribute__((always_inline)) void step(struct i8080 *cpu, uint8_t *memory, const uint8_t live, const int lazy) {
 #define SWAP(x,y) {x^=y;y^=x;x^=y;}
-#define D16 (b[2] << 8 | b[1])
+#define D16 rd16(b + 1)
+#define ST(addr, v) store8(cpu, memory, (addr), (v))
+#define ST16(addr, v) store16(cpu, memory, (addr), (v))
 #define gBC rpBC(cpu)
 #define gDE rpDE(cpu)
 #define gHL rpHL(cpu)
@@ -71,379 +161,455 @@ void execute_instruction(struct i8080 *cpu, uint8_t *memory, void (*out)(uint8_t
 #define sDE(x) srpDE(cpu, (x))
 #define sHL(x) srpHL(cpu, (x))
 
-#define fZ(x) setFlag(cpu, Z, (x) == 0)
-#define fS(x) setFlag(cpu, S, ((x)&0x80) >> 7)
-#define fP(x) setFlag(cpu, P, !parity((x)))
-
-#define DAD(x) {setFlag(cpu, CY, gHL > 0xFFFF - x); sHL(gHL + x);}
-
-#define XRA(x) {cpu->A^=x; fZ(cpu->A); fS(cpu->A); fP(cpu->A); setFlag(cpu, CY, 0); setFlag(cpu, AC, 0);}
-#define ANA(x) {cpu->A&=x; fZ(cpu->A); fS(cpu->A); fP(cpu->A); setFlag(cpu, CY, 0); /* TODO AC */}
-#define ADD(x) {\
-	setFlag(cpu, CY, cpu->A > 255 - x);\
-	cpu->A += x;\
-	fZ(cpu->A); fS(cpu->A); fP(cpu->A);\
+#define SET(flag, val) { if(live & (1 << (flag))) setFlag(cpu, (flag), (val)); }
+#define fZ(x) SET(Z, (x) == 0)
+#define fS(x) SET(S, ((x)&0x80) >> 7)
+#define fP(x) SET(P, !parity((x)))
+#define fZSP(x) {fZ(x); fS(x); fP(x); if(lazy) cpu->lazy = (x);}
+
+#define DAD(x) {const uint32_t sum = gHL + (x); SET(CY, sum > 0xFFFF); sHL(sum);}
+
+// INR/DCR leave CY alone. AC is the carry out of bit 3 of the 4 bit add/subtract.
+#define INR(r) {(r) ++; fZSP(r); SET(AC, ((r) & 0xF) == 0x0);}
+#define DCR(r) {(r) --; fZSP(r); SET(AC, ((r) & 0xF) != 0xF);}
+
+#define XRA(x) {cpu->A^=(x); fZSP(cpu->A); SET(CY, 0); SET(AC, 0);}
+#define ORA(x) {cpu->A|=(x); fZSP(cpu->A); SET(CY, 0); SET(AC, 0);}
+// the 8080 sets AC on ANA from the OR of bit 3 of both operands
+#define ANA(x) {const uint8_t v = (x); SET(AC, ((cpu->A | v) & 0x08) != 0); cpu->A&=v; fZSP(cpu->A); SET(CY, 0);}
+#define ADC(x, c) {\
+	const uint8_t v = (x); \
+	const uint16_t sum = cpu->A + v + (c); \
+	SET(AC, ((cpu->A & 0xF) + (v & 0xF) + (c)) > 0xF); \
+	SET(CY, sum > 0xFF); \
+	cpu->A = sum; \
+	fZSP(cpu->A); \
 }
-#define ADC(x) {\
-	const uint16_t sum = cpu->A + x + getFlag(cpu, CY); \
-	setFlag(cpu, CY, sum > 255); \
-	fZ(cpu->A); fS(cpu->A); fP(cpu->A); \
+#define ADD(x) ADC(x, 0)
+// subtraction is done as A + ~x + 1 (minus the borrow), CY ends up being the inverted carry
+#define SBB(x, c) {\
+	const uint8_t v = (x); \
+	const uint16_t diff = cpu->A - v - (c); \
+	SET(AC, ((cpu->A & 0xF) + (~v & 0xF) + !(c)) > 0xF); \
+	SET(CY, diff > 0xFF); \
+	cpu->A = diff; \
+	fZSP(cpu->A); \
 }
+#define SUB(x) SBB(x, 0)
+#define CMP(x) {const uint8_t a = cpu->A; SUB(x); cpu->A = a;}
+
+#define PUSH(hi, lo) { \
+		cpu->sp -= 2; \
+		ST16(cpu->sp, (hi) << 8 | (lo)); \
+	}
+#define POP(hi, lo) {const uint16_t v = rd16(memory + cpu->sp); (lo) = v; (hi) = v >> 8; cpu->sp += 2;}
+
+#define JMP_IF(cond) { if(cond) cpu->pc = D16; }
+#define CALL { \
+		PUSH(cpu->pc >> 8, cpu->pc & 0xFF); \
+		cpu->pc = D16; \
+	}
+#define RET { \
+		cpu->pc = rd16(memory + cpu->sp); \
+		cpu->sp += 2; \
+	}
+#define IN(port) in(cpu->ports, (port))
+#define OUT(port, data) out(cpu->ports, (port), (data))
+
+#define CALL_IF(cond) { if(cond) { CALL; cpu->clock_cnt += taken[op] - cycles[op]; } }
+#define RET_IF(cond) { if(cond) { RET; cpu->clock_cnt += taken[op] - cycles[op]; } }
+
+	// a halted CPU sits idle until an interrupt comes
+	if(getFlag(cpu, HLT)) { cpu->clock_cnt += 4; return; }
 
 	uint8_t* b = memory + cpu->pc;
-	// setFlag(cpu, CY, cpu->B == 0); // will result in a borrow
+	const uint8_t op = b[0];
+
+	if(cpu->recorder) {
+		// the register file is laid out exactly like the start of a record,
+		// so a record is just two 8 byte words
+		uint64_t regs, ops;
+		uint32_t sppc, opcode;
+		memcpy(&regs, cpu, 8);
+		memcpy(&sppc, &cpu->sp, 4);
+		memcpy(&opcode, b, 4);
+		ops = sppc | (uint64_t)(opcode & 0xFFFFFF) << 32;
+
+		struct flight_recorder *rec = cpu->recorder;
+		uint64_t *slot = (uint64_t *)&rec->ring[rec->pos ++ & (FLIGHT_RECORDS - 1)];
+		slot[0] = regs;
+		slot[1] = ops;
+	}
 
 	uint8_t bit;
-	switch(b[0]) {
-/*NOP*/	case 0x00: /* do nothing :D */; cpu->pc += 1; break;
-/*LXI*/	case 0x01: cpu->B = b[2]; cpu->C = b[1]; cpu->pc += 3; break;
-/*STAX*/case 0x02: memory[gBC] = cpu->A; cpu->pc += 1; break;
-/*INX*/	case 0x03: sBC(gBC+1); cpu->pc += 1; break;
-		case 0x04: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DCR*/	case 0x05: cpu->B --; fZ(cpu->B); fS(cpu->B); fP(cpu->B); cpu->pc += 1; break;
-/*MVI*/	case 0x06: cpu->B = b[1]; cpu->pc += 2; break;
-		case 0x07: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x08: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DAD*/	case 0x09: DAD(gBC); cpu->pc += 1; break;
-		case 0x0a: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x0b: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x0c: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DCR*/	case 0x0d: cpu->C --; fZ(cpu->C); fS(cpu->C); fP(cpu->C); cpu->pc += 1; break;
-/*MVI*/ case 0x0e: cpu->C = b[1]; cpu->pc += 2; break;
-		case 0x0f:
+	uint16_t tmp16;
+	// everything but jumps, calls and returns just goes on to the next one
+	cpu->pc += length[op];
+	switch(op) {
+/*NOP*/	case 0x00: /* do nothing :D */; break;
+/*LXI*/	case 0x01: cpu->B = b[2]; cpu->C = b[1]; break;
+/*STAX*/case 0x02: ST(gBC, cpu->A); break;
+/*INX*/	case 0x03: sBC(gBC+1); break;
+/*INR*/	case 0x04: INR(cpu->B); break;
+/*DCR*/	case 0x05: DCR(cpu->B); break;
+/*MVI*/	case 0x06: cpu->B = b[1]; break;
+/*RLC*/	case 0x07:
+			bit = cpu->A >> 7;
+			cpu->A = (cpu->A << 1) | bit;
+			SET(CY, bit);
+			break;
+		case 0x08: unimplemented(cpu, memory); break;
+/*DAD*/	case 0x09: DAD(gBC); break;
+/*LDAX*/case 0x0a: cpu->A = memory[gBC]; break;
+/*DCX*/	case 0x0b: sBC(gBC-1); break;
+/*INR*/	case 0x0c: INR(cpu->C); break;
+/*DCR*/	case 0x0d: DCR(cpu->C); break;
+/*MVI*/ case 0x0e: cpu->C = b[1]; break;
+/*RRC*/	case 0x0f:
 			bit = cpu->A & 1;
 			cpu->A >>= 1;
-			cpu->A |= (bit << 8);
-			setFlag(cpu, CY, bit);
-			cpu->pc += 1;
+			cpu->A |= (bit << 7);
+			SET(CY, bit);
+			break;
+		case 0x10: unimplemented(cpu, memory); break;
+/*LXI*/	case 0x11: cpu->D = b[2]; cpu->E = b[1]; break;
+/*STAX*/case 0x12: ST(gDE, cpu->A); break;
+/*INX*/	case 0x13: sDE(gDE+1); break;
+/*INR*/	case 0x14: INR(cpu->D); break;
+/*DCR*/	case 0x15: DCR(cpu->D); break;
+/*MVI*/	case 0x16: cpu->D = b[1]; break;
+/*RAL*/	case 0x17:
+			bit = cpu->A >> 7;
+			cpu->A = (cpu->A << 1) | getFlag(cpu, CY);
+			SET(CY, bit);
+			break;
+		case 0x18: unimplemented(cpu, memory); break;
+/*DAD*/	case 0x19: DAD(gDE); break;
+/*LDAX*/case 0x1a: cpu->A = memory[gDE]; break;
+/*DCX*/	case 0x1b: sDE(gDE-1); break;
+/*INR*/	case 0x1c: INR(cpu->E); break;
+/*DCR*/	case 0x1d: DCR(cpu->E); break;
+/*MVI*/	case 0x1e: cpu->E = b[1]; break;
+/*RAR*/	case 0x1f:
+			bit = cpu->A & 1;
+			cpu->A = (cpu->A >> 1) | (getFlag(cpu, CY) << 7);
+			SET(CY, bit);
 			break;
-/*DEB*/	case 0x10: printf("DEB\n"); cpu->pc += 1; break;
-/*LXI*/	case 0x11: cpu->D = b[2]; cpu->E = b[1]; cpu->pc += 3; break;
-		case 0x12: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*INX*/	case 0x13: sDE(gDE+1); cpu->pc += 1; break;
-		case 0x14: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DCR*/	case 0x15: cpu->D --; fZ(cpu->D); fS(cpu->D); fP(cpu->D); cpu->pc += 1; break;
-/*MVI*/	case 0x16: cpu->D = b[1]; cpu->pc += 2; break;
-		case 0x17: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x18: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DAD*/	case 0x19: DAD(gDE); cpu->pc += 1; break;
-/*LDAX*/case 0x1a: cpu->A = memory[gDE]; cpu->pc += 1; break;
-		case 0x1b: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x1c: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DCR*/	case 0x1d: cpu->E --; fZ(cpu->E); fS(cpu->E); fP(cpu->E); cpu->pc += 1; break;
-/*MVI*/	case 0x1e: cpu->E = b[1]; cpu->pc += 2; break;
-		case 0x1f: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x20: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*LXI*/	case 0x21: cpu->H = b[2]; cpu->L = b[1]; cpu->pc += 3; break;
-		case 0x22: unimplemented(cpu, memory); cpu->pc += 3; break;
-/*INX*/	case 0x23: sHL(gHL + 1); cpu->pc += 1; break;
-		case 0x24: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DCR*/	case 0x25: cpu->H --; fZ(cpu->H); fS(cpu->H); fP(cpu->H); cpu->pc += 1; break;
-/*MVI*/	case 0x26: cpu->H = b[1]; cpu->pc += 2; break;
-		case 0x27: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x28: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DAD*/	case 0x29: DAD(gHL); cpu->pc += 1; break;
-		case 0x2a: unimplemented(cpu, memory); cpu->pc += 3; break;
-		case 0x2b: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x2c: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DCR*/	case 0x2d: cpu->L --; fZ(cpu->L); fS(cpu->L); fP(cpu->L); cpu->pc += 1; break;
-/*MVI*/	case 0x2e: cpu->L = b[1]; cpu->pc += 2; break;
-		case 0x2f: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x30: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*LXI*/	case 0x31: cpu->sp = D16; cpu->pc += 3; break;
-/*STA*/ case 0x32: memory[D16] = cpu->A; cpu->pc += 3; break;
-/*INX*/	case 0x33: cpu->sp ++; cpu->pc += 1; break;
-		case 0x34: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DCR*/	case 0x35: memory[gHL] --; fZ(memory[gHL]); fS(memory[gHL]); fP(memory[gHL]); cpu->pc += 1; break;
-/*MVI*/	case 0x36: memory[gHL] = b[1]; cpu->pc += 2; break;
-		case 0x37: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x38: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DAD*/	case 0x39: DAD(cpu->sp); cpu->pc += 1; break;
-/*LDA*/	case 0x3a: cpu->A = memory[D16]; cpu->pc += 3; break;
-		case 0x3b: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x3c: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*DCR*/	case 0x3d: cpu->A --; fZ(cpu->A); fS(cpu->A); fP(cpu->A); cpu->pc += 1; break;
-/*MVI*/ case 0x3e: cpu->A = b[1]; cpu->pc += 2; break;
-		case 0x3f: unimplemented(cpu, memory); cpu->pc += 1; break;
+		case 0x20: unimplemented(cpu, memory); break;
+/*LXI*/	case 0x21: cpu->H = b[2]; cpu->L = b[1]; break;
+/*SHLD*/case 0x22: ST16(D16, gHL); break;
+/*INX*/	case 0x23: sHL(gHL + 1); break;
+/*INR*/	case 0x24: INR(cpu->H); break;
+/*DCR*/	case 0x25: DCR(cpu->H); break;
+/*MVI*/	case 0x26: cpu->H = b[1]; break;
+/*DAA*/	case 0x27: {
+			uint8_t correction = 0;
+			bit = getFlag(cpu, CY);
+			if((cpu->A & 0xF) > 9 || getFlag(cpu, AC)) correction |= 0x06;
+			if(cpu->A > 0x99 || bit) { correction |= 0x60; bit = 1; }
+			ADD(correction);
+			SET(CY, bit);
+			break;
+		}
+		case 0x28: unimplemented(cpu, memory); break;
+/*DAD*/	case 0x29: DAD(gHL); break;
+/*LHLD*/case 0x2a: sHL(rd16(memory + D16)); break;
+/*DCX*/	case 0x2b: sHL(gHL - 1); break;
+/*INR*/	case 0x2c: INR(cpu->L); break;
+/*DCR*/	case 0x2d: DCR(cpu->L); break;
+/*MVI*/	case 0x2e: cpu->L = b[1]; break;
+/*CMA*/	case 0x2f: cpu->A = ~cpu->A; break;
+		case 0x30: unimplemented(cpu, memory); break;
+/*LXI*/	case 0x31: cpu->sp = D16; break;
+/*STA*/ case 0x32: ST(D16, cpu->A); break;
+/*INX*/	case 0x33: cpu->sp ++; break;
+/*INR*/	case 0x34: bit = memory[gHL]; INR(bit); ST(gHL, bit); break;
+/*DCR*/	case 0x35: bit = memory[gHL]; DCR(bit); ST(gHL, bit); break;
+/*MVI*/	case 0x36: ST(gHL, b[1]); break;
+/*STC*/	case 0x37: SET(CY, 1); break;
+		case 0x38: unimplemented(cpu, memory); break;
+/*DAD*/	case 0x39: DAD(cpu->sp); break;
+/*LDA*/	case 0x3a: cpu->A = memory[D16]; break;
+/*DCX*/	case 0x3b: cpu->sp --; break;
+/*INR*/	case 0x3c: INR(cpu->A); break;
+/*DCR*/	case 0x3d: DCR(cpu->A); break;
+/*MVI*/ case 0x3e: cpu->A = b[1]; break;
+/*CMC*/	case 0x3f: SET(CY, !getFlag(cpu, CY)); break;
 
 /* block of a lot of MOVs */
 
-/*MOV*/	case 0x40: cpu->B = cpu->B;      cpu->pc += 1; break;
-/*MOV*/	case 0x41: cpu->B = cpu->C;      cpu->pc += 1; break;
-/*MOV*/	case 0x42: cpu->B = cpu->D;      cpu->pc += 1; break;
-/*MOV*/	case 0x43: cpu->B = cpu->E;      cpu->pc += 1; break;
-/*MOV*/	case 0x44: cpu->B = cpu->H;      cpu->pc += 1; break;
-/*MOV*/	case 0x45: cpu->B = cpu->L;      cpu->pc += 1; break;
-/*MOV*/	case 0x46: cpu->B = memory[gHL]; cpu->pc += 1; break;
-/*MOV*/	case 0x47: cpu->B = cpu->A;      cpu->pc += 1; break;
-
-/*MOV*/	case 0x48: cpu->C = cpu->B;      cpu->pc += 1; break;
-/*MOV*/	case 0x49: cpu->C = cpu->C;      cpu->pc += 1; break;
-/*MOV*/	case 0x4a: cpu->C = cpu->D;      cpu->pc += 1; break;
-/*MOV*/	case 0x4b: cpu->C = cpu->E;      cpu->pc += 1; break;
-/*MOV*/	case 0x4c: cpu->C = cpu->H;      cpu->pc += 1; break;
-/*MOV*/	case 0x4d: cpu->C = cpu->L;      cpu->pc += 1; break;
-/*MOV*/	case 0x4e: cpu->C = memory[gHL]; cpu->pc += 1; break;
-/*MOV*/	case 0x4f: cpu->C = cpu->A;      cpu->pc += 1; break;
-
-/*MOV*/	case 0x50: cpu->D = cpu->B;      cpu->pc += 1; break;
-/*MOV*/	case 0x51: cpu->D = cpu->C;      cpu->pc += 1; break;
-/*MOV*/	case 0x52: cpu->D = cpu->D;      cpu->pc += 1; break;
-/*MOV*/	case 0x53: cpu->D = cpu->E;      cpu->pc += 1; break;
-/*MOV*/	case 0x54: cpu->D = cpu->H;      cpu->pc += 1; break;
-/*MOV*/	case 0x55: cpu->D = cpu->L;      cpu->pc += 1; break;
-/*MOV*/	case 0x56: cpu->D = memory[gHL]; cpu->pc += 1; break;
-/*MOV*/	case 0x57: cpu->D = cpu->A;      cpu->pc += 1; break;
-
-/*MOV*/	case 0x58: cpu->E = cpu->B;      cpu->pc += 1; break;
-/*MOV*/	case 0x59: cpu->E = cpu->C;      cpu->pc += 1; break;
-/*MOV*/	case 0x5a: cpu->E = cpu->D;      cpu->pc += 1; break;
-/*MOV*/	case 0x5b: cpu->E = cpu->E;      cpu->pc += 1; break;
-/*MOV*/	case 0x5c: cpu->E = cpu->H;      cpu->pc += 1; break;
-/*MOV*/	case 0x5d: cpu->E = cpu->L;      cpu->pc += 1; break;
-/*MOV*/	case 0x5e: cpu->E = memory[gHL]; cpu->pc += 1; break;
-/*MOV*/	case 0x5f: cpu->E = cpu->A;      cpu->pc += 1; break;
-
-/*MOV*/	case 0x60: cpu->H = cpu->B;      cpu->pc += 1; break;
-/*MOV*/	case 0x61: cpu->H = cpu->C;      cpu->pc += 1; break;
-/*MOV*/	case 0x62: cpu->H = cpu->D;      cpu->pc += 1; break;
-/*MOV*/	case 0x63: cpu->H = cpu->E;      cpu->pc += 1; break;
-/*MOV*/	case 0x64: cpu->H = cpu->H;      cpu->pc += 1; break;
-/*MOV*/	case 0x65: cpu->H = cpu->L;      cpu->pc += 1; break;
-/*MOV*/	case 0x66: cpu->H = memory[gHL]; cpu->pc += 1; break;
-/*MOV*/	case 0x67: cpu->H = cpu->A;      cpu->pc += 1; break;
-
-/*MOV*/	case 0x68: cpu->L = cpu->B;      cpu->pc += 1; break;
-/*MOV*/	case 0x69: cpu->L = cpu->C;      cpu->pc += 1; break;
-/*MOV*/	case 0x6a: cpu->L = cpu->D;      cpu->pc += 1; break;
-/*MOV*/	case 0x6b: cpu->L = cpu->E;      cpu->pc += 1; break;
-/*MOV*/	case 0x6c: cpu->L = cpu->H;      cpu->pc += 1; break;
-/*MOV*/	case 0x6d: cpu->L = cpu->L;      cpu->pc += 1; break;
-/*MOV*/	case 0x6e: cpu->L = memory[gHL]; cpu->pc += 1; break;
-/*MOV*/	case 0x6f: cpu->L = cpu->A;      cpu->pc += 1; break;
-
-/*MOV*/	case 0x70: memory[gHL] = cpu->B; cpu->pc += 1; break;
-/*MOV*/	case 0x71: memory[gHL] = cpu->C; cpu->pc += 1; break;
-/*MOV*/	case 0x72: memory[gHL] = cpu->D; cpu->pc += 1; break;
-/*MOV*/	case 0x73: memory[gHL] = cpu->E; cpu->pc += 1; break;
-/*MOV*/	case 0x74: memory[gHL] = cpu->H; cpu->pc += 1; break;
-/*MOV*/	case 0x75: memory[gHL] = cpu->L; cpu->pc += 1; break;
-/*HLT*/ case 0x76: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*MOV*/	case 0x77: memory[gHL] = cpu->A; cpu->pc += 1; break;
-
-/*MOV*/	case 0x78: cpu->A = cpu->B;      cpu->pc += 1; break;
-/*MOV*/	case 0x79: cpu->A = cpu->C;      cpu->pc += 1; break;
-/*MOV*/	case 0x7a: cpu->A = cpu->D;      cpu->pc += 1; break;
-/*MOV*/	case 0x7b: cpu->A = cpu->E;      cpu->pc += 1; break;
-/*MOV*/	case 0x7c: cpu->A = cpu->H;      cpu->pc += 1; break;
-/*MOV*/	case 0x7d: cpu->A = cpu->L;      cpu->pc += 1; break;
-/*MOV*/	case 0x7e: cpu->A = memory[gHL]; cpu->pc += 1; break;
-/*MOV*/	case 0x7f: cpu->A = cpu->A;      cpu->pc += 1; break; // WTF why is this needed
-
-/*ADD*/	case 0x80: ADD(cpu->B     ); cpu->pc += 1; break;
-/*ADD*/	case 0x81: ADD(cpu->C     ); cpu->pc += 1; break;
-/*ADD*/	case 0x82: ADD(cpu->D     ); cpu->pc += 1; break;
-/*ADD*/	case 0x83: ADD(cpu->E     ); cpu->pc += 1; break;
-/*ADD*/	case 0x84: ADD(cpu->H     ); cpu->pc += 1; break;
-/*ADD*/	case 0x85: ADD(cpu->L     ); cpu->pc += 1; break;
-/*ADD*/	case 0x86: ADD(memory[gHL]); cpu->pc += 1; break;
-/*ADD*/	case 0x87: ADD(cpu->A     ); cpu->pc += 1; break;
-
-/*ADC*/	case 0x88: ADC(cpu->B     ); cpu->pc += 1; break;
-/*ADC*/	case 0x89: ADC(cpu->C     ); cpu->pc += 1; break;
-/*ADC*/	case 0x8a: ADC(cpu->D     ); cpu->pc += 1; break;
-/*ADC*/	case 0x8b: ADC(cpu->E     ); cpu->pc += 1; break;
-/*ADC*/	case 0x8c: ADC(cpu->H     ); cpu->pc += 1; break;
-/*ADC*/	case 0x8d: ADC(cpu->L     ); cpu->pc += 1; break;
-/*ADC*/	case 0x8e: ADC(memory[gHL]); cpu->pc += 1; break;
-/*ADC*/	case 0x8f: ADC(cpu->A     ); cpu->pc += 1; break;
-
-		case 0x90: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x91: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x92: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x93: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x94: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x95: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x96: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x97: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x98: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x99: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x9a: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x9b: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x9c: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x9d: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x9e: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0x9f: unimplemented(cpu, memory); cpu->pc += 1; break;
-
-/*ANA*/	case 0xa0: ANA(cpu->B     ); cpu->pc += 1; break;
-/*ANA*/	case 0xa1: ANA(cpu->C     ); cpu->pc += 1; break;
-/*ANA*/	case 0xa2: ANA(cpu->D     ); cpu->pc += 1; break;
-/*ANA*/	case 0xa3: ANA(cpu->E     ); cpu->pc += 1; break;
-/*ANA*/	case 0xa4: ANA(cpu->H     ); cpu->pc += 1; break;
-/*ANA*/	case 0xa5: ANA(cpu->L     ); cpu->pc += 1; break;
-/*ANA*/	case 0xa6: ANA(memory[gHL]); cpu->pc += 1; break;
-/*ANA*/	case 0xa7: ANA(cpu->A     ); cpu->pc += 1; break;
-
-/*XRA*/	case 0xa8: XRA(cpu->B     ); cpu->pc += 1; break;
-/*XRA*/	case 0xa9: XRA(cpu->C     ); cpu->pc += 1; break;
-/*XRA*/	case 0xaa: XRA(cpu->D     ); cpu->pc += 1; break;
-/*XRA*/	case 0xab: XRA(cpu->E     ); cpu->pc += 1; break;
-/*XRA*/	case 0xac: XRA(cpu->H     ); cpu->pc += 1; break;
-/*XRA*/	case 0xad: XRA(cpu->L     ); cpu->pc += 1; break;
-/*XRA*/	case 0xae: XRA(memory[gHL]); cpu->pc += 1; break;
-/*XRA*/	case 0xaf: XRA(cpu->A     ); cpu->pc += 1; break;
-
-		case 0xb0: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb1: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb2: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb3: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb4: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb5: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb6: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb7: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb8: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xb9: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xba: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xbb: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xbc: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xbd: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xbe: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xbf: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xc0: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*POP*/	case 0xc1: cpu->C=memory[cpu->sp]; cpu->B=memory[cpu->sp+1]; cpu->sp += 2; ; cpu->pc += 1; break;
-/*JNZ*/	case 0xc2:
-			if(!getFlag(cpu, Z)) { cpu->pc = D16; }
-			else { cpu->pc += 3; }
-		break;
+/*MOV*/	case 0x40: cpu->B = cpu->B;      break;
+/*MOV*/	case 0x41: cpu->B = cpu->C;      break;
+/*MOV*/	case 0x42: cpu->B = cpu->D;      break;
+/*MOV*/	case 0x43: cpu->B = cpu->E;      break;
+/*MOV*/	case 0x44: cpu->B = cpu->H;      break;
+/*MOV*/	case 0x45: cpu->B = cpu->L;      break;
+/*MOV*/	case 0x46: cpu->B = memory[gHL]; break;
+/*MOV*/	case 0x47: cpu->B = cpu->A;      break;
+
+/*MOV*/	case 0x48: cpu->C = cpu->B;      break;
+/*MOV*/	case 0x49: cpu->C = cpu->C;      break;
+/*MOV*/	case 0x4a: cpu->C = cpu->D;      break;
+/*MOV*/	case 0x4b: cpu->C = cpu->E;      break;
+/*MOV*/	case 0x4c: cpu->C = cpu->H;      break;
+/*MOV*/	case 0x4d: cpu->C = cpu->L;      break;
+/*MOV*/	case 0x4e: cpu->C = memory[gHL]; break;
+/*MOV*/	case 0x4f: cpu->C = cpu->A;      break;
+
+/*MOV*/	case 0x50: cpu->D = cpu->B;      break;
+/*MOV*/	case 0x51: cpu->D = cpu->C;      break;
+/*MOV*/	case 0x52: cpu->D = cpu->D;      break;
+/*MOV*/	case 0x53: cpu->D = cpu->E;      break;
+/*MOV*/	case 0x54: cpu->D = cpu->H;      break;
+/*MOV*/	case 0x55: cpu->D = cpu->L;      break;
+/*MOV*/	case 0x56: cpu->D = memory[gHL]; break;
+/*MOV*/	case 0x57: cpu->D = cpu->A;      break;
+
+/*MOV*/	case 0x58: cpu->E = cpu->B;      break;
+/*MOV*/	case 0x59: cpu->E = cpu->C;      break;
+/*MOV*/	case 0x5a: cpu->E = cpu->D;      break;
+/*MOV*/	case 0x5b: cpu->E = cpu->E;      break;
+/*MOV*/	case 0x5c: cpu->E = cpu->H;      break;
+/*MOV*/	case 0x5d: cpu->E = cpu->L;      break;
+/*MOV*/	case 0x5e: cpu->E = memory[gHL]; break;
+/*MOV*/	case 0x5f: cpu->E = cpu->A;      break;
+
+/*MOV*/	case 0x60: cpu->H = cpu->B;      break;
+/*MOV*/	case 0x61: cpu->H = cpu->C;      break;
+/*MOV*/	case 0x62: cpu->H = cpu->D;      break;
+/*MOV*/	case 0x63: cpu->H = cpu->E;      break;
+/*MOV*/	case 0x64: cpu->H = cpu->H;      break;
+/*MOV*/	case 0x65: cpu->H = cpu->L;      break;
+/*MOV*/	case 0x66: cpu->H = memory[gHL]; break;
+/*MOV*/	case 0x67: cpu->H = cpu->A;      break;
+
+/*MOV*/	case 0x68: cpu->L = cpu->B;      break;
+/*MOV*/	case 0x69: cpu->L = cpu->C;      break;
+/*MOV*/	case 0x6a: cpu->L = cpu->D;      break;
+/*MOV*/	case 0x6b: cpu->L = cpu->E;      break;
+/*MOV*/	case 0x6c: cpu->L = cpu->H;      break;
+/*MOV*/	case 0x6d: cpu->L = cpu->L;      break;
+/*MOV*/	case 0x6e: cpu->L = memory[gHL]; break;
+/*MOV*/	case 0x6f: cpu->L = cpu->A;      break;
+
+/*MOV*/	case 0x70: ST(gHL, cpu->B); break;
+/*MOV*/	case 0x71: ST(gHL, cpu->C); break;
+/*MOV*/	case 0x72: ST(gHL, cpu->D); break;
+/*MOV*/	case 0x73: ST(gHL, cpu->E); break;
+/*MOV*/	case 0x74: ST(gHL, cpu->H); break;
+/*MOV*/	case 0x75: ST(gHL, cpu->L); break;
+/*HLT*/ case 0x76: setFlag(cpu, HLT, 1); break;
+/*MOV*/	case 0x77: ST(gHL, cpu->A); break;
+
+/*MOV*/	case 0x78: cpu->A = cpu->B;      break;
+/*MOV*/	case 0x79: cpu->A = cpu->C;      break;
+/*MOV*/	case 0x7a: cpu->A = cpu->D;      break;
+/*MOV*/	case 0x7b: cpu->A = cpu->E;      break;
+/*MOV*/	case 0x7c: cpu->A = cpu->H;      break;
+/*MOV*/	case 0x7d: cpu->A = cpu->L;      break;
+/*MOV*/	case 0x7e: cpu->A = memory[gHL]; break;
+/*MOV*/	case 0x7f: cpu->A = cpu->A;      break; // WTF why is this needed
+
+/*ADD*/	case 0x80: ADD(cpu->B     ); break;
+/*ADD*/	case 0x81: ADD(cpu->C     ); break;
+/*ADD*/	case 0x82: ADD(cpu->D     ); break;
+/*ADD*/	case 0x83: ADD(cpu->E     ); break;
+/*ADD*/	case 0x84: ADD(cpu->H     ); break;
+/*ADD*/	case 0x85: ADD(cpu->L     ); break;
+/*ADD*/	case 0x86: ADD(memory[gHL]); break;
+/*ADD*/	case 0x87: ADD(cpu->A     ); break;
+
+/*ADC*/	case 0x88: ADC(cpu->B     , getFlag(cpu, CY)); break;
+/*ADC*/	case 0x89: ADC(cpu->C     , getFlag(cpu, CY)); break;
+/*ADC*/	case 0x8a: ADC(cpu->D     , getFlag(cpu, CY)); break;
+/*ADC*/	case 0x8b: ADC(cpu->E     , getFlag(cpu, CY)); break;
+/*ADC*/	case 0x8c: ADC(cpu->H     , getFlag(cpu, CY)); break;
+/*ADC*/	case 0x8d: ADC(cpu->L     , getFlag(cpu, CY)); break;
+/*ADC*/	case 0x8e: ADC(memory[gHL], getFlag(cpu, CY)); break;
+/*ADC*/	case 0x8f: ADC(cpu->A     , getFlag(cpu, CY)); break;
+
+/*SUB*/	case 0x90: SUB(cpu->B     ); break;
+/*SUB*/	case 0x91: SUB(cpu->C     ); break;
+/*SUB*/	case 0x92: SUB(cpu->D     ); break;
+/*SUB*/	case 0x93: SUB(cpu->E     ); break;
+/*SUB*/	case 0x94: SUB(cpu->H     ); break;
+/*SUB*/	case 0x95: SUB(cpu->L     ); break;
+/*SUB*/	case 0x96: SUB(memory[gHL]); break;
+/*SUB*/	case 0x97: SUB(cpu->A     ); break;
+
+/*SBB*/	case 0x98: SBB(cpu->B     , getFlag(cpu, CY)); break;
+/*SBB*/	case 0x99: SBB(cpu->C     , getFlag(cpu, CY)); break;
+/*SBB*/	case 0x9a: SBB(cpu->D     , getFlag(cpu, CY)); break;
+/*SBB*/	case 0x9b: SBB(cpu->E     , getFlag(cpu, CY)); break;
+/*SBB*/	case 0x9c: SBB(cpu->H     , getFlag(cpu, CY)); break;
+/*SBB*/	case 0x9d: SBB(cpu->L     , getFlag(cpu, CY)); break;
+/*SBB*/	case 0x9e: SBB(memory[gHL], getFlag(cpu, CY)); break;
+/*SBB*/	case 0x9f: SBB(cpu->A     , getFlag(cpu, CY)); break;
+
+/*ANA*/	case 0xa0: ANA(cpu->B     ); break;
+/*ANA*/	case 0xa1: ANA(cpu->C     ); break;
+/*ANA*/	case 0xa2: ANA(cpu->D     ); break;
+/*ANA*/	case 0xa3: ANA(cpu->E     ); break;
+/*ANA*/	case 0xa4: ANA(cpu->H     ); break;
+/*ANA*/	case 0xa5: ANA(cpu->L     ); break;
+/*ANA*/	case 0xa6: ANA(memory[gHL]); break;
+/*ANA*/	case 0xa7: ANA(cpu->A     ); break;
+
+/*XRA*/	case 0xa8: XRA(cpu->B     ); break;
+/*XRA*/	case 0xa9: XRA(cpu->C     ); break;
+/*XRA*/	case 0xaa: XRA(cpu->D     ); break;
+/*XRA*/	case 0xab: XRA(cpu->E     ); break;
+/*XRA*/	case 0xac: XRA(cpu->H     ); break;
+/*XRA*/	case 0xad: XRA(cpu->L     ); break;
+/*XRA*/	case 0xae: XRA(memory[gHL]); break;
+/*XRA*/	case 0xaf: XRA(cpu->A     ); break;
+
+/*ORA*/	case 0xb0: ORA(cpu->B     ); break;
+/*ORA*/	case 0xb1: ORA(cpu->C     ); break;
+/*ORA*/	case 0xb2: ORA(cpu->D     ); break;
+/*ORA*/	case 0xb3: ORA(cpu->E     ); break;
+/*ORA*/	case 0xb4: ORA(cpu->H     ); break;
+/*ORA*/	case 0xb5: ORA(cpu->L     ); break;
+/*ORA*/	case 0xb6: ORA(memory[gHL]); break;
+/*ORA*/	case 0xb7: ORA(cpu->A     ); break;
+
+/*CMP*/	case 0xb8: CMP(cpu->B     ); break;
+/*CMP*/	case 0xb9: CMP(cpu->C     ); break;
+/*CMP*/	case 0xba: CMP(cpu->D     ); break;
+/*CMP*/	case 0xbb: CMP(cpu->E     ); break;
+/*CMP*/	case 0xbc: CMP(cpu->H     ); break;
+/*CMP*/	case 0xbd: CMP(cpu->L     ); break;
+/*CMP*/	case 0xbe: CMP(memory[gHL]); break;
+/*CMP*/	case 0xbf: CMP(cpu->A     ); break;
+
+/*RNZ*/	case 0xc0: RET_IF(!getFlag(cpu, Z)); break;
+/*POP*/	case 0xc1: POP(cpu->B, cpu->C); break;
+/*JNZ*/	case 0xc2: JMP_IF(!getFlag(cpu, Z)); break;
 /*JMP*/	case 0xc3: cpu->pc = D16; break;
-		case 0xc4: unimplemented(cpu, memory); cpu->pc += 3; break;
-/*PUSH*/case 0xc5:
-			memory[cpu->sp-1] = cpu->B;
-			memory[cpu->sp-2] = cpu->C;
-			cpu->sp -= 2;
-			cpu->pc += 1;
-		break;
-/*ADI*/	case 0xc6:
-		setFlag(cpu, CY, cpu->A > 255 - b[1]);
-		cpu->A += b[1];
-		fZ(cpu->A); fS(cpu->A); fP(cpu->A);
-		cpu->pc += 2;
-		break;
+/*CNZ*/	case 0xc4: CALL_IF(!getFlag(cpu, Z)); break;
+/*PUSH*/case 0xc5: PUSH(cpu->B, cpu->C); break;
+/*ADI*/	case 0xc6: ADD(b[1]); break;
 /*RST*/	case 0xc7: RST(0); break;
-/*RZ*/	case 0xc8: if(getFlag(cpu, Z) == 0) break; // else, waterfall to RET
-/*RET*/	case 0xc9:
-			cpu->pc = ((uint16_t)memory[cpu->sp+1] << 8) | memory[cpu->sp];
-			cpu->sp += 2;
-			break;
-		case 0xca: unimplemented(cpu, memory); cpu->pc += 3; break;
-		case 0xcb: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xcc: unimplemented(cpu, memory); cpu->pc += 3; break;
+/*RZ*/	case 0xc8: RET_IF(getFlag(cpu, Z)); break;
+/*RET*/	case 0xc9: RET; break;
+/*JZ*/	case 0xca: JMP_IF(getFlag(cpu, Z)); break;
+		case 0xcb: unimplemented(cpu, memory); break;
+/*CZ*/	case 0xcc: CALL_IF(getFlag(cpu, Z)); break;
 /*CALL*/case 0xcd:
-			cpu->pc += 3; // if CALL saved its own address in the stack, RET would call again
+			// if CALL saved its own address in the stack, RET would call again
 			// leading to infinite recursion. Instead, call saves the address of the next instruction
-			memory[cpu->sp-1] = (cpu->pc & 0xFF00) >> 8;
-			memory[cpu->sp-2] = (cpu->pc & 0x00FF);
-			cpu->sp -= 2;
-			cpu->pc = D16;
+			CALL;
 		break;
-		case 0xce: unimplemented(cpu, memory); cpu->pc += 2; break;
+/*ACI*/	case 0xce: ADC(b[1], getFlag(cpu, CY)); break;
 /*RST*/	case 0xcf: RST(1); break;
-		case 0xd0: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*POP*/	case 0xd1: cpu->E=memory[cpu->sp]; cpu->D=memory[cpu->sp+1]; cpu->sp += 2; cpu->pc += 1; break;
-		case 0xd2: unimplemented(cpu, memory); cpu->pc += 3; break;
-/*OUT*/	case 0xd3: out(b[1], cpu->A); cpu->pc += 2; break;
-		case 0xd4: unimplemented(cpu, memory); cpu->pc += 3; break;
-/*PUSH*/case 0xd5:
-			memory[cpu->sp-1] = cpu->D;
-			memory[cpu->sp-2] = cpu->E;
-			cpu->sp -= 2;
-			cpu->pc += 1;
-		break;
-		case 0xd6: unimplemented(cpu, memory); cpu->pc += 2; break;
+/*RNC*/	case 0xd0: RET_IF(!getFlag(cpu, CY)); break;
+/*POP*/	case 0xd1: POP(cpu->D, cpu->E); break;
+/*JNC*/	case 0xd2: JMP_IF(!getFlag(cpu, CY)); break;
+/*OUT*/	case 0xd3: OUT(b[1], cpu->A); break;
+/*CNC*/	case 0xd4: CALL_IF(!getFlag(cpu, CY)); break;
+/*PUSH*/case 0xd5: PUSH(cpu->D, cpu->E); break;
+/*SUI*/	case 0xd6: SUB(b[1]); break;
 /*RST*/	case 0xd7: RST(2); break;
-		case 0xd8: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xd9: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xda: unimplemented(cpu, memory); cpu->pc += 3; break;
-/*IN*/	case 0xdb: printf("IN %02x\n", b[1]); cpu->A = cpu->input_ports[b[1]]; cpu->pc += 2; break;
-		case 0xdc: unimplemented(cpu, memory); cpu->pc += 3; break;
-		case 0xdd: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xde: unimplemented(cpu, memory); cpu->pc += 2; break;
+/*RC*/	case 0xd8: RET_IF(getFlag(cpu, CY)); break;
+		case 0xd9: unimplemented(cpu, memory); break;
+/*JC*/	case 0xda: JMP_IF(getFlag(cpu, CY)); break;
+/*IN*/	case 0xdb: cpu->A = IN(b[1]); break;
+/*CC*/	case 0xdc: CALL_IF(getFlag(cpu, CY)); break;
+		case 0xdd: unimplemented(cpu, memory); break;
+/*SBI*/	case 0xde: SBB(b[1], getFlag(cpu, CY)); break;
 /*RST*/	case 0xdf: RST(3); break;
-		case 0xe0: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*POP*/	case 0xe1: cpu->L=memory[cpu->sp]; cpu->H=memory[cpu->sp+1]; cpu->sp += 2; cpu->pc += 1; break;
-		case 0xe2: unimplemented(cpu, memory); cpu->pc += 3; break;
-		case 0xe3: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xe4: unimplemented(cpu, memory); cpu->pc += 3; break;
-/*PUSH*/case 0xe5:
-			memory[cpu->sp-1] = cpu->H;
-			memory[cpu->sp-2] = cpu->L;
-			cpu->sp -= 2;
-			cpu->pc += 1;
-		break;
-		case 0xe6: cpu->A &= b[1]; setFlag(cpu, CY, 0); cpu->pc += 2; break;
+/*RPO*/	case 0xe0: RET_IF(!getFlag(cpu, P)); break;
+/*POP*/	case 0xe1: POP(cpu->H, cpu->L); break;
+/*JPO*/	case 0xe2: JMP_IF(!getFlag(cpu, P)); break;
+/*XTHL*/case 0xe3:
+			tmp16 = rd16(memory + cpu->sp);
+			ST16(cpu->sp, gHL);
+			sHL(tmp16);
+			break;
+/*CPO*/	case 0xe4: CALL_IF(!getFlag(cpu, P)); break;
+/*PUSH*/case 0xe5: PUSH(cpu->H, cpu->L); break;
+/*ANI*/	case 0xe6: ANA(b[1]); break;
 /*RST*/	case 0xe7: RST(4); break;
-		case 0xe8: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xe9: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xea: unimplemented(cpu, memory); cpu->pc += 3; break;
-/*XCHG*/case 0xeb: SWAP(cpu->H, cpu->D); SWAP(cpu->L, cpu->E); cpu->pc += 1; break;
-		case 0xec: unimplemented(cpu, memory); cpu->pc += 3; break;
-		case 0xed: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xee: unimplemented(cpu, memory); cpu->pc += 2; break;
+/*RPE*/	case 0xe8: RET_IF(getFlag(cpu, P)); break;
+/*PCHL*/case 0xe9: cpu->pc = gHL; break;
+/*JPE*/	case 0xea: JMP_IF(getFlag(cpu, P)); break;
+/*XCHG*/case 0xeb: SWAP(cpu->H, cpu->D); SWAP(cpu->L, cpu->E); break;
+/*CPE*/	case 0xec: CALL_IF(getFlag(cpu, P)); break;
+		case 0xed: unimplemented(cpu, memory); break;
+/*XRI*/	case 0xee: XRA(b[1]); break;
 /*RST*/	case 0xef: RST(5); break;
-/*RP*/	case 0xf0:
-			if(getFlag(cpu, P)) {
-				printf("HERE %02x %02x\n", memory[cpu->sp+1], memory[cpu->sp]);
-				cpu->pc = ((uint16_t)memory[cpu->sp+1] << 8) | memory[cpu->sp];
-				cpu->sp += 2;
-			} else {
-				cpu->pc += 1;
-			}
-			break;
+/*RP*/	case 0xf0: RET_IF(!getFlag(cpu, S)); break;
 /*POP*/	case 0xf1: // POP PSW
-			cpu->A = memory[cpu->sp+1];
-			setFlag(cpu, CY, (memory[cpu->sp] >> 0) & 1);
-			setFlag(cpu, P , (memory[cpu->sp] >> 2) & 1);
-			setFlag(cpu, AC, (memory[cpu->sp] >> 4) & 1);
-			setFlag(cpu, Z , (memory[cpu->sp] >> 6) & 1);
-			setFlag(cpu, S , (memory[cpu->sp] >> 7) & 1);
-			cpu->sp += 2;
-			cpu->pc += 1;
+			POP(cpu->A, bit);
+			SET(CY, (bit >> 0) & 1);
+			SET(P, (bit >> 2) & 1);
+			SET(AC, (bit >> 4) & 1);
+			SET(Z, (bit >> 6) & 1);
+			SET(S, (bit >> 7) & 1);
 			break;
-		case 0xf2: unimplemented(cpu, memory); cpu->pc += 3; break;
-/*DI*/	case 0xf3: setFlag(cpu, EI, 0); cpu->pc += 1; break;
-		case 0xf4: unimplemented(cpu, memory); cpu->pc += 3; break;
+/*JP*/	case 0xf2: JMP_IF(!getFlag(cpu, S)); break;
+/*DI*/	case 0xf3: setFlag(cpu, EI, 0); break;
+/*CP*/	case 0xf4: CALL_IF(!getFlag(cpu, S)); break;
 /*PUSH*/case 0xf5: // PUSH PSW - saves flags into memory
-			memory[cpu->sp-1] = cpu->A;
-			memory[cpu->sp-2] = (getFlag(cpu, CY) << 0)
-			                  | (0                << 1) // TODO should be 1 per intel docs
-			                  | (getFlag(cpu, P ) << 2)
-			                  | (0                << 3)
-			                  | (getFlag(cpu, AC) << 4) // TODO change to getFlag(cpu, AC) when AC is working correctly
-			                  | (0                << 5)
-			                  | (getFlag(cpu, Z ) << 6)
-			                  | (getFlag(cpu, S ) << 7);
-			cpu->sp -= 2;
-			cpu->pc += 1;
+			PUSH(cpu->A,
+			      (getFlag(cpu, CY) << 0)
+			    | (1                << 1) // always 1 per intel docs
+			    | (getFlag(cpu, P ) << 2)
+			    | (0                << 3)
+			    | (getFlag(cpu, AC) << 4)
+			    | (0                << 5)
+			    | (getFlag(cpu, Z ) << 6)
+			    | (getFlag(cpu, S ) << 7));
 			break;
-		case 0xf6: unimplemented(cpu, memory); cpu->pc += 2; break;
+/*ORI*/	case 0xf6: ORA(b[1]); break;
 /*RST*/	case 0xf7: RST(6); break;
-		case 0xf8: unimplemented(cpu, memory); cpu->pc += 1; break;
-		case 0xf9: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*JM*/	case 0xfa: if(getFlag(cpu, S)) cpu->pc = D16; break;
-/*EI*/	case 0xfb: setFlag(cpu, EI, 1); cpu->pc += 1; break;
-		case 0xfc: unimplemented(cpu, memory); cpu->pc += 3; break;
-		case 0xfd: unimplemented(cpu, memory); cpu->pc += 1; break;
-/*CPI*/	case 0xfe:
-			setFlag(cpu, CY, cpu->A < b[1]);
-			const uint8_t tmp = cpu->A - b[1];
-			fZ(tmp); fS(tmp); fP(tmp);
-			cpu->pc += 2;
-		break;
+/*RM*/	case 0xf8: RET_IF(getFlag(cpu, S)); break;
+/*SPHL*/case 0xf9: cpu->sp = gHL; break;
+/*JM*/	case 0xfa: JMP_IF(getFlag(cpu, S)); break;
+/*EI*/	case 0xfb: setFlag(cpu, EI, 1); break;
+/*CM*/	case 0xfc: CALL_IF(getFlag(cpu, S)); break;
+		case 0xfd: unimplemented(cpu, memory); break;
+/*CPI*/	case 0xfe: CMP(b[1]); break;
 /*RST*/	case 0xff: RST(7); break;
 	}
 	cpu->instr ++;
+	cpu->clock_cnt += cycles[op];
 
 #undef D16
+#undef ST
+#undef ST16
+#undef SET
 
 }
 
+void execute_instruction(struct i8080 *cpu, uint8_t *memory) {
+	step(cpu, memory, F_ALL, 0);
+}
+
+// one copy per set of flags, S and P always come together with everything
+#define VARIANT(name, live) static void name(struct i8080 *cpu, uint8_t *memory) { step(cpu, memory, (live), 1); }
+VARIANT(step_none, 0)
+VARIANT(step_z, F_Z)
+VARIANT(step_cy, F_CY)
+VARIANT(step_z_cy, F_Z | F_CY)
+VARIANT(step_ac, F_AC)
+VARIANT(step_z_ac, F_Z | F_AC)
+VARIANT(step_cy_ac, F_CY | F_AC)
+VARIANT(step_z_cy_ac, F_Z | F_CY | F_AC)
+VARIANT(step_all, F_ALL)
+#undef VARIANT
+
+execute_fn execute_variant(uint8_t live) {
+	static const execute_fn variants[8] = {
+		step_none, step_z, step_cy, step_z_cy, step_ac, step_z_ac, step_cy_ac, step_z_cy_ac,
+	};
+	if(live & (F_S | F_P)) return step_all;
+	return variants[(live & F_Z ? 1 : 0) | (live & F_CY ? 2 : 0) | (live & F_AC ? 4 : 0)];
+}
+
+void flags_flush(struct i8080 *cpu) {
+	if(cpu->deferred & F_Z) setFlag(cpu, Z, cpu->lazy == 0);
+	if(cpu->deferred & F_S) setFlag(cpu, S, cpu->lazy >> 7);
+	if(cpu->deferred & F_P) setFlag(cpu, P, !parity(cpu->lazy));
+	cpu->deferred = 0;
+}
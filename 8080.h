@@ -1,15 +1,64 @@
 #include <stdint.h> // uint8_t, uint16_t
 
+struct flight_recorder;
+struct code_watch;
+
+// What IN and OUT talk to. Set up once and point cpu->ports at it; without
+// it every port reads 0 and writes go nowhere.
+struct ports {
+	uint8_t (*in[256])(void *ctx, uint8_t port); // NULL - IN reads value[port] instead
+	void (*out[256])(void *ctx, uint8_t port, uint8_t data); // NULL - OUT is ignored
+	uint8_t value[256]; // for ports that just hold a value, no call needed
+	void *ctx; // passed to every handler
+};
+
 struct i8080 {
 	uint8_t A, B, C, D, E, H, L; // registers
 	uint8_t flags;
 	uint16_t sp, pc;
-	int clock_cnt;//TODO
+	uint64_t clock_cnt; // clock cycles executed so far
 	int instr; // for debug purposes only
-	uint8_t input_ports[256];
+	struct ports *ports; // optional
+	struct flight_recorder *recorder; // optional, see flight.h
+	uint8_t *dirty; // optional, DIRTY_SIZE bytes, see below
+
+	// Z, S and P may be left out of date by the block runner (block.h):
+	// the ones in deferred have to be worked out from lazy, the result of
+	// the last instruction that set them. Always 0 outside of it.
+	uint8_t deferred, lazy;
+	struct code_watch *watch; // optional, see below
 };
 
-void execute_instruction(struct i8080 *cpu, uint8_t *memory, void (*out)(uint8_t,uint8_t));
+// When cpu->dirty is set, every write to memory also sets the byte for its
+// 1 << DIRTY_SHIFT byte block there. Nobody but the owner clears them.
+#define DIRTY_SHIFT 5
+#define DIRTY_SIZE (0x10000 >> DIRTY_SHIFT)
+
+// Whoever keeps code translated (block.h) needs to hear about writes to
+// it. With cpu->watch set, a write to a block of the same size as above
+// whose byte is set in map calls written after it is done.
+struct code_watch {
+	uint8_t map[DIRTY_SIZE];
+	void (*written)(struct code_watch *watch, uint16_t addr, uint32_t len);
+};
+
+// for code that writes guest memory on its own instead of through
+// execute_instruction, len bytes from addr: sets cpu->dirty and tells the
+// watch, the same as the CPU's own writes do
+void memory_written(struct i8080 *cpu, uint16_t addr, uint32_t len);
+
+void execute_instruction(struct i8080 *cpu, uint8_t *memory);
+
+// execute_instruction, but only the flags in live (F_ bits of ops.h) are
+// sure to be computed, the rest may keep stale values. Z, S and P results
+// are always kept in cpu->lazy. The function returned may do more flags
+// than asked for.
+typedef void (*execute_fn)(struct i8080 *cpu, uint8_t *memory);
+execute_fn execute_variant(uint8_t live);
+
+// work out the deferred flags, after this cpu->flags is right again
+void flags_flush(struct i8080 *cpu);
+
 void request_interrupt(struct i8080 *cpu, uint8_t *memory, uint8_t RST);
 
 // for debugging purposes
@@ -25,6 +74,7 @@ enum flag {
 };
 
 uint8_t getFlag(struct i8080* cpu, enum flag flag);
+void setFlag(struct i8080 *cpu, const uint8_t flag, const uint8_t val);
 
 // get register pair
 uint16_t rpBC(struct i8080* cpu);
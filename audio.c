@@ -0,0 +1,215 @@
+#include <string.h> // memset, memcpy
+
+#include "audio.h"
+
+// how the ring depth moves, in samples
+#define DEPTH_START 384
+#define DEPTH_MIN 128
+#define DEPTH_MAX (AUDIO_RING / 2)
+#define DEPTH_GROW 64
+#define DEPTH_SHRINK 32
+#define DEPTH_CALM (AUDIO_RATE * 30) // this long without an underrun and it shrinks
+
+#define CHUNK 256 // samples generated at a time
+
+// the effects, in the order of struct audio's voices
+static const struct sound {
+	uint8_t port, bit;
+	uint16_t from, to; // Hz, swept linearly
+	uint16_t ms;
+	uint8_t noise; // random instead of a square wave, clocked at the frequency
+	uint8_t loop; // starts over for as long as the bit stays set
+	int16_t volume;
+} sounds[AUDIO_SOUNDS] = {
+	{3, 0,  500,  700,  100, 0, 1, 2500}, // UFO flying
+	{3, 1, 1800,  400,  250, 0, 0, 3000}, // shot
+	{3, 2,  300,  300, 1000, 1, 0, 5000}, // player dies
+	{3, 3, 1200, 1200,  300, 1, 0, 4000}, // invader dies
+	{3, 4, 1000, 1000,  600, 0, 0, 2500}, // extra life
+	{5, 0,  100,  100,  100, 0, 0, 5000}, // fleet movement, 4 steps
+	{5, 1,   90,   90,  100, 0, 0, 5000},
+	{5, 2,   80,   80,  100, 0, 0, 5000},
+	{5, 3,   70,   70,  100, 0, 0, 5000},
+	{5, 4, 1200,  300,  800, 0, 0, 3000}, // UFO hit
+};
+
+#define AMP_ENABLE (1 << 5) // port 3, everything is quiet without it
+
+static uint32_t step_of(uint32_t hz) {
+	return (uint64_t)hz * (1ULL << 32) / AUDIO_RATE;
+}
+
+static void start(struct voice *v, const struct sound *s) {
+	const uint32_t len = (uint32_t)s->ms * AUDIO_RATE / 1000;
+	v->left = len;
+	v->phase = 0;
+	v->step = step_of(s->from);
+	v->sweep = ((int64_t)step_of(s->to) - step_of(s->from)) / len;
+	if(v->noise == 0) v->noise = 1;
+}
+
+void audio_init(struct audio *audio, uint64_t cpu_hz, uint32_t fps) {
+	memset(audio, 0, sizeof(struct audio));
+	audio->cpu_hz = cpu_hz;
+	audio->frame = AUDIO_RATE / fps;
+	atomic_init(&audio->head, 0);
+	atomic_init(&audio->tail, 0);
+	atomic_init(&audio->depth, DEPTH_START);
+	audio->buffering = 1;
+}
+
+// the current value of each bit of ports 3 and 5, one bit per sound
+static int held(const struct audio *audio, const struct sound *s) {
+	return ((s->port == 3 ? audio->port3 : audio->port5) >> s->bit) & 1;
+}
+
+static void synth(struct audio *audio, int16_t *out, uint32_t count) {
+	memset(out, 0, count * sizeof(int16_t));
+	if((audio->port3 & AMP_ENABLE) == 0) {
+		// the sounds still play out, they just can't be heard
+		for(int i = 0;i < AUDIO_SOUNDS;i ++) {
+			struct voice *v = &audio->voice[i];
+			v->left = v->left > count ? v->left - count : 0;
+		}
+		return;
+	}
+
+	for(int i = 0;i < AUDIO_SOUNDS;i ++) {
+		struct voice *v = &audio->voice[i];
+		const struct sound *s = &sounds[i];
+		const uint32_t len = (uint32_t)s->ms * AUDIO_RATE / 1000;
+
+		for(uint32_t n = 0;n < count && v->left;n ++) {
+			const uint32_t prev = v->phase;
+			v->phase += v->step;
+			v->step += v->sweep;
+
+			int high;
+			if(s->noise) {
+				// clock a 15 bit LFSR every time the phase wraps around
+				if(v->phase < prev) v->noise = (v->noise >> 1) | (((v->noise ^ (v->noise >> 1)) & 1) << 14);
+				high = v->noise & 1;
+			} else {
+				high = v->phase >> 31;
+			}
+
+			// looping sounds stay at full volume, the others fade out
+			const int32_t amp = s->loop ? s->volume : (int32_t)s->volume * v->left / len;
+			const int32_t mixed = out[n] + (high ? amp : -amp);
+			out[n] = mixed > 32767 ? 32767 : mixed < -32768 ? -32768 : mixed;
+
+			if(-- v->left == 0 && s->loop && held(audio, s)) start(v, s);
+		}
+	}
+}
+
+static void emit(struct audio *audio, const int16_t *samples, uint32_t count) {
+	if(audio->wav) {
+		audio->wav_samples += fwrite(samples, sizeof(int16_t), count, audio->wav);
+		return;
+	}
+
+	const uint32_t head = atomic_load_explicit(&audio->head, memory_order_relaxed);
+	const uint32_t tail = atomic_load_explicit(&audio->tail, memory_order_acquire);
+	const uint32_t fill = head - tail;
+
+	// past the wanted depth the samples are dropped, that happens when the
+	// emulator runs faster than the sound card plays
+	const uint32_t limit = audio->frame + atomic_load_explicit(&audio->depth, memory_order_relaxed);
+	const uint32_t room = fill < limit ? limit - fill : 0;
+	const uint32_t n = count < room ? count : room;
+
+	for(uint32_t i = 0;i < n;i ++) audio->ring[(head + i) & (AUDIO_RING - 1)] = samples[i];
+	audio->dropped += count - n;
+	atomic_store_explicit(&audio->head, head + n, memory_order_release);
+}
+
+void audio_run(struct audio *audio, uint64_t cycle) {
+	const uint64_t target = cycle * AUDIO_RATE / audio->cpu_hz;
+	while(audio->pos < target) {
+		int16_t chunk[CHUNK];
+		const uint32_t n = target - audio->pos < CHUNK ? target - audio->pos : CHUNK;
+		synth(audio, chunk, n);
+		emit(audio, chunk, n);
+		audio->pos += n;
+	}
+}
+
+void audio_out(struct audio *audio, uint8_t port, uint8_t data, uint64_t cycle) {
+	// everything before the write still sounds the old way
+	audio_run(audio, cycle);
+
+	const uint8_t old = port == 3 ? audio->port3 : audio->port5;
+	if(port == 3) audio->port3 = data;
+	else audio->port5 = data;
+
+	for(int i = 0;i < AUDIO_SOUNDS;i ++) {
+		const struct sound *s = &sounds[i];
+		if(s->port != port) continue;
+
+		const int was = (old >> s->bit) & 1, is = (data >> s->bit) & 1;
+		if(is && !was) start(&audio->voice[i], s);
+		if(was && !is && s->loop) audio->voice[i].left = 0;
+	}
+}
+
+void audio_pull(struct audio *audio, int16_t *out, uint32_t count) {
+	const uint32_t tail = atomic_load_explicit(&audio->tail, memory_order_relaxed);
+	const uint32_t head = atomic_load_explicit(&audio->head, memory_order_acquire);
+	const uint32_t avail = head - tail;
+	uint32_t depth = atomic_load_explicit(&audio->depth, memory_order_relaxed);
+
+	// after running dry, stay quiet until there is a cushion again
+	if(audio->buffering && avail < depth) {
+		memset(out, 0, count * sizeof(int16_t));
+		return;
+	}
+	audio->buffering = 0;
+
+	const uint32_t n = count < avail ? count : avail;
+	for(uint32_t i = 0;i < n;i ++) out[i] = audio->ring[(tail + i) & (AUDIO_RING - 1)];
+	memset(out + n, 0, (count - n) * sizeof(int16_t));
+	atomic_store_explicit(&audio->tail, tail + n, memory_order_release);
+
+	if(n < count) {
+		audio->underruns ++;
+		audio->buffering = 1;
+		audio->clean = 0;
+		if(depth + DEPTH_GROW <= DEPTH_MAX) depth += DEPTH_GROW;
+	} else if((audio->clean += count) >= DEPTH_CALM) {
+		// the cap in emit then trims the cushion down
+		audio->clean = 0;
+		if(depth >= DEPTH_MIN + DEPTH_SHRINK) depth -= DEPTH_SHRINK;
+	}
+	atomic_store_explicit(&audio->depth, depth, memory_order_relaxed);
+}
+
+// 16 bit mono PCM, the sizes are filled in by audio_close
+static void wav_header(FILE *f, uint32_t samples) {
+	const uint32_t data = samples * sizeof(int16_t);
+	const uint32_t riff = 36 + data, fmt_len = 16, rate = AUDIO_RATE, byte_rate = AUDIO_RATE * 2;
+	const uint16_t format = 1, channels = 1, align = 2, bits = 16;
+
+	fwrite("RIFF", 1, 4, f); fwrite(&riff, 4, 1, f);
+	fwrite("WAVEfmt ", 1, 8, f); fwrite(&fmt_len, 4, 1, f);
+	fwrite(&format, 2, 1, f); fwrite(&channels, 2, 1, f);
+	fwrite(&rate, 4, 1, f); fwrite(&byte_rate, 4, 1, f);
+	fwrite(&align, 2, 1, f); fwrite(&bits, 2, 1, f);
+	fwrite("data", 1, 4, f); fwrite(&data, 4, 1, f);
+}
+
+int audio_wav(struct audio *audio, const char *path) {
+	audio->wav = fopen(path, "wb");
+	if(audio->wav == NULL) return -1;
+	wav_header(audio->wav, 0);
+	audio->wav_samples = 0;
+	return 0;
+}
+
+void audio_close(struct audio *audio) {
+	if(audio->wav == NULL) return;
+	fseek(audio->wav, 0, SEEK_SET);
+	wav_header(audio->wav, audio->wav_samples);
+	fclose(audio->wav);
+	audio->wav = NULL;
+}
@@ -0,0 +1,63 @@
+#include <stdint.h> // int16_t, uint32_t, uint64_t
+#include <stdatomic.h>
+#include <stdio.h> // FILE
+
+// Sound for the Space Invaders board. The game switches the cabinet's sound
+// effects on and off through bits of ports 3 and 5, those writes come in
+// here stamped with the emulated cycle they happened at. The effects are
+// synthesised (square waves, noise and sweeps, not recordings of the real
+// ones) into 16 bit mono samples, in emulated time.
+//
+// The samples go either into a WAV file or into a ring that the sound card
+// drains from its own thread. The emulator writes to the ring and the audio
+// callback reads from it, neither locks. The ring is kept only as full as
+// needed to not run dry: after an underrun playback waits for a slightly
+// deeper cushion, a long time without one makes it shallower again.
+
+#define AUDIO_RATE 44100
+#define AUDIO_RING (1 << 14) // samples, must be a power of two
+
+#define AUDIO_SOUNDS 10
+
+struct voice {
+	uint32_t left; // samples until it is over, 0 when silent
+	uint32_t phase, step; // square wave phase, step per sample
+	int32_t sweep; // added to step every sample
+	uint32_t noise; // LFSR state, for the noisy sounds
+};
+
+struct audio {
+	uint64_t cpu_hz;
+	uint64_t pos; // samples generated so far
+	uint8_t port3, port5; // last written values
+	struct voice voice[AUDIO_SOUNDS];
+
+	FILE *wav; // when set, samples go here instead of the ring
+	uint64_t wav_samples;
+
+	int16_t ring[AUDIO_RING];
+	atomic_uint head, tail; // written / read sample counts, wrap around
+	atomic_uint depth; // cushion of samples kept in the ring, it may hold a frame more than that
+	uint32_t frame; // samples in one video frame
+	uint32_t clean; // samples read since the last underrun
+	int buffering; // waiting for the ring to fill up to depth
+	uint64_t underruns, dropped; // for the curious
+};
+
+void audio_init(struct audio *audio, uint64_t cpu_hz, uint32_t fps);
+
+// write everything to a WAV file from now on. Returns -1 if it can't be created.
+int audio_wav(struct audio *audio, const char *path);
+
+// finishes the WAV file if there is one
+void audio_close(struct audio *audio);
+
+// a write to port 3 or 5
+void audio_out(struct audio *audio, uint8_t port, uint8_t data, uint64_t cycle);
+
+// generate samples up to the given cycle, call it at least once a frame
+void audio_run(struct audio *audio, uint64_t cycle);
+
+// for the audio callback: take count samples out of the ring. Whatever is
+// missing is filled with silence and counted as an underrun.
+void audio_pull(struct audio *audio, int16_t *out, uint32_t count);
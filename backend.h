@@ -0,0 +1,42 @@
+#include <stdint.h> // uint32_t
+
+// What the frontend needs from a window system: showing frames, reading
+// the user's input and playing sound. Each backend is a single instance
+// that keeps its state to itself.
+
+struct frame;
+struct audio;
+
+struct backend_options {
+	int scale; // every pixel is a scale x scale block
+	int mono; // no colored overlay
+};
+
+// what the user did
+struct input {
+	uint32_t buttons; // held down right now, see enum invaders_button
+	int turbo; // times fast forward was switched since the last poll
+	int quit;
+};
+
+struct backend {
+	const char *name;
+	int (*open)(const struct backend_options *options); // 0, or -1 if it can't
+	void (*close)(void);
+
+	// handle pending events, input keeps its value between calls
+	void (*poll)(struct input *input);
+
+	// show the frame. Only the columns in frame->dirty changed since the last
+	// one, they are cleared. NULL if nothing is shown at all.
+	void (*present)(struct frame *frame);
+
+	// start pulling samples out of audio's ring, -1 if there is no sound
+	int (*play)(struct audio *audio);
+
+	// the display's refresh rate in Hz, 0 if unknown
+	int (*refresh)(void);
+};
+
+extern const struct backend backend_sdl;
+extern const struct backend backend_null;
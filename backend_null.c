@@ -0,0 +1,22 @@
+#include <stddef.h> // NULL
+
+#include "backend.h"
+
+// For batch runs: no window, no input, no sound. Frames can still be
+// recorded with the capture.
+
+static int open_null(const struct backend_options *options) { return 0; }
+static void close_null(void) {}
+static void poll_null(struct input *input) {}
+static int play_null(struct audio *audio) { return -1; }
+static int refresh_null(void) { return 0; }
+
+const struct backend backend_null = {
+	.name = "null",
+	.open = open_null,
+	.close = close_null,
+	.poll = poll_null,
+	.present = NULL,
+	.play = play_null,
+	.refresh = refresh_null,
+};
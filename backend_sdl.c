@@ -0,0 +1,193 @@
+#include <SDL2/SDL.h>
+
+#include "backend.h"
+#include "fb.h"
+#include "triple.h"
+#include "audio.h"
+#include "invaders.h"
+
+static SDL_Window *window;
+static SDL_Renderer *renderer;
+static SDL_Texture *texture;
+static SDL_AudioDeviceID device;
+
+// how the screen is drawn
+static struct {
+	int scale;
+	const uint32_t *colors; // per row, NULL for plain white
+	uint32_t *pixels; // the last converted frame, only the parts that changed get redone
+	int pitch;
+} output;
+
+// re-expand and upload the dirty columns between x0 and x1. fb_scale
+// works on 16 column tiles anyway, so runs of dirty tiles are done at once.
+static void updateTexture(const uint8_t *vram, uint8_t *dirty, int x0, int x1) {
+	x0 &= ~15;
+
+	int run = -1; // first column of the current run of dirty tiles
+	for(int x = x0;x < x1 || run >= 0;x += 16) {
+		uint64_t d[2] = {0, 0};
+		if(x < x1) memcpy(d, dirty + x, 16);
+
+		if(d[0] | d[1]) {
+			if(run < 0) run = x;
+			memset(dirty + x, 0, 16);
+			continue;
+		}
+		if(run < 0) continue;
+
+		const int end = x < FB_WIDTH ? x : FB_WIDTH;
+		fb_scale(vram, (uint8_t *)output.pixels, output.pitch, run, end, output.scale, output.colors);
+		const SDL_Rect rect = {run * output.scale, 0, (end - run) * output.scale, FB_HEIGHT * output.scale};
+		SDL_UpdateTexture(texture, &rect, output.pixels + run * output.scale, output.pitch);
+		run = -1;
+	}
+}
+
+static int open_sdl(const struct backend_options *options) {
+	if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS) != 0) {
+		printf("SDL_Init failed: %s\n", SDL_GetError());
+		return -1;
+	}
+
+	// scaled and colored on the CPU, so that the texture is the finished picture
+	static uint32_t overlay[FB_HEIGHT];
+	fb_overlay(overlay);
+	output.scale = options->scale;
+	output.colors = options->mono ? NULL : overlay;
+	output.pitch = FB_WIDTH * output.scale * 4;
+	output.pixels = calloc(FB_HEIGHT * output.scale, output.pitch);
+
+	//const unsigned int texWidth = 256, texHeight = 224;
+	const unsigned int texWidth = FB_WIDTH * output.scale, texHeight = FB_HEIGHT * output.scale;
+	window = SDL_CreateWindow(
+		"space invaders emulator",
+		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+		texWidth, texHeight,
+		SDL_WINDOW_SHOWN
+	);
+	if(window == NULL) {
+		printf("SDL_CreateWindow failed: %s\n", SDL_GetError());
+		return -1;
+	}
+
+	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+
+	SDL_RendererInfo info;
+	SDL_GetRendererInfo(renderer, &info);
+	printf("Renderer name: %s\n", info.name);
+	printf("Framebuffer conversion: %s\n", fb_impl());
+	/*
+	printf("Texture formats:\n");
+	for(int i = 0;i < info.num_texture_formats;i ++) {
+		printf("%s\n", SDL_GetPixelFormatName(info.texture_formats[i]));
+	}
+	*/
+
+	texture = SDL_CreateTexture(
+		renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+		texWidth, texHeight
+	);
+	return 0;
+}
+
+static void close_sdl(void) {
+	if(device) SDL_CloseAudioDevice(device);
+	free(output.pixels);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+}
+
+// which key is which button
+static const struct {
+	SDL_Scancode key;
+	enum invaders_button button;
+} keymap[] = {
+	{SDL_SCANCODE_C, INVADERS_COIN},
+	{SDL_SCANCODE_1, INVADERS_P1_START},
+	{SDL_SCANCODE_2, INVADERS_P2_START},
+	{SDL_SCANCODE_SPACE, INVADERS_P1_FIRE},
+	{SDL_SCANCODE_LEFT, INVADERS_P1_LEFT},
+	{SDL_SCANCODE_RIGHT, INVADERS_P1_RIGHT},
+	{SDL_SCANCODE_W, INVADERS_P2_FIRE},
+	{SDL_SCANCODE_A, INVADERS_P2_LEFT},
+	{SDL_SCANCODE_D, INVADERS_P2_RIGHT},
+};
+
+static void key(struct input *input, SDL_Scancode code, int down) {
+	if(code == SDL_SCANCODE_TAB && down) input->turbo ++;
+
+	for(size_t i = 0;i < sizeof(keymap) / sizeof(keymap[0]);i ++) {
+		if(keymap[i].key != code) continue;
+		if(down) input->buttons |= 1u << keymap[i].button;
+		else input->buttons &= ~(1u << keymap[i].button);
+	}
+}
+
+static void poll_sdl(struct input *input) {
+	SDL_Event event;
+	while(SDL_PollEvent(&event)) {
+		switch(event.type) {
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:
+				if(event.key.repeat) break;
+				key(input, event.key.keysym.scancode, event.type == SDL_KEYDOWN);
+				break;
+			case SDL_WINDOWEVENT:
+				if(event.window.event == SDL_WINDOWEVENT_CLOSE) input->quit = 1;
+				break;
+			case SDL_QUIT:
+				input->quit = 1;
+				break;
+			default: break;
+		}
+	}
+}
+
+static void present_sdl(struct frame *frame) {
+	updateTexture(frame->vram, frame->dirty, 0, FB_WIDTH);
+
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, texture, NULL, NULL);
+	SDL_RenderPresent(renderer);
+}
+
+// called from SDL's audio thread
+static void callback(void *userdata, Uint8 *stream, int len) {
+	audio_pull(userdata, (int16_t *)stream, len / sizeof(int16_t));
+}
+
+static int play_sdl(struct audio *audio) {
+	// small device buffers, the ring in between takes care of the rest
+	SDL_AudioSpec want = {0};
+	want.freq = AUDIO_RATE;
+	want.format = AUDIO_S16SYS;
+	want.channels = 1;
+	want.samples = 256;
+	want.callback = callback;
+	want.userdata = audio;
+	device = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
+	if(device == 0) {
+		printf("No sound: %s\n", SDL_GetError());
+		return -1;
+	}
+	SDL_PauseAudioDevice(device, 0);
+	return 0;
+}
+
+static int refresh_sdl(void) {
+	SDL_DisplayMode mode;
+	if(SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) != 0) return 0;
+	return mode.refresh_rate;
+}
+
+const struct backend backend_sdl = {
+	.name = "sdl",
+	.open = open_sdl,
+	.close = close_sdl,
+	.poll = poll_sdl,
+	.present = present_sdl,
+	.play = play_sdl,
+	.refresh = refresh_sdl,
+};
@@ -0,0 +1,240 @@
+#include <stdio.h> // fprintf
+#include <stdlib.h> // calloc
+#include <string.h> // memset
+
+#include "8080.h"
+#include "block.h"
+#include "idiom.h"
+#include "ops.h"
+
+struct block {
+	uint16_t start;
+	uint8_t n; // instructions
+	uint8_t len; // bytes
+	uint8_t check; // bytes watched for writes, len or the loop's if longer
+	uint8_t live_in; // flags read before they are written
+	uint8_t defer; // Z, S and P left in cpu->lazy at the end
+	uint8_t valid; // cleared when its code is written to
+	uint8_t stop; // block_run returns before running it
+	uint8_t end; // enum flow of the last instruction
+	uint16_t target; // where the jump, call or RST at the end goes
+	uint32_t cycles; // at most, conditional calls and returns taken
+	// the blocks run after this one, filled in the first time each is:
+	// falling through (or returning from the call at the end), and target
+	struct block *link[2];
+	execute_fn step[BLOCK_MAX];
+	struct idiom idiom; // a copy or fill loop starts here
+};
+
+struct blocks {
+	struct code_watch watch; // first, written gets a pointer to it
+	struct block *at[0x10000]; // the block starting at each address
+	struct block pool[BLOCK_POOL];
+	uint32_t used, flushes;
+	uint8_t stop[0x10000 / 8]; // see block_stop
+
+	struct ret {
+		uint16_t pc; // where the call returns to
+		struct block *caller;
+	} rets[BLOCK_RETS];
+	uint32_t depth;
+
+	uint64_t translated, chained, invalidated;
+};
+
+static void written(struct code_watch *watch, uint16_t addr, uint32_t len);
+
+struct blocks *blocks_create(void) {
+	struct blocks *blocks = calloc(1, sizeof(struct blocks));
+	if(blocks) blocks->watch.written = written;
+	return blocks;
+}
+
+void blocks_destroy(struct blocks *blocks) {
+	free(blocks);
+}
+
+void blocks_report(FILE *f, const struct blocks *blocks) {
+	fprintf(f, "Blocks: %llu decoded, %llu dropped after writes, %llu flushes, %llu chained\n",
+			(unsigned long long)blocks->translated, (unsigned long long)blocks->invalidated,
+			(unsigned long long)blocks->flushes, (unsigned long long)blocks->chained);
+}
+
+void block_stop(struct blocks *blocks, uint16_t addr) {
+	blocks->stop[addr >> 3] |= 1 << (addr & 7);
+	if(blocks->at[addr]) blocks->at[addr]->stop = 1;
+}
+
+// forget everything, when the pool runs out
+static void flush(struct blocks *blocks) {
+	for(uint32_t i = 0;i < blocks->used;i ++) blocks->pool[i].valid = 0;
+	memset(blocks->at, 0, sizeof(blocks->at));
+	memset(blocks->watch.map, 0, DIRTY_SIZE);
+	blocks->used = 0;
+	blocks->depth = 0;
+	blocks->flushes ++;
+}
+
+// a write to len bytes from addr, drop every block with code there. Links
+// to them are noticed and dropped when they are next followed.
+static void written(struct code_watch *watch, uint16_t addr, uint32_t len) {
+	struct blocks *blocks = (struct blocks *)watch;
+	const uint32_t span = len + BLOCK_BYTES - 1 > 0x10000 ? 0x10000 : len + BLOCK_BYTES - 1;
+	for(uint32_t i = 0;i < span;i ++) {
+		const uint16_t start = addr + len - 1 - i;
+		struct block *b = blocks->at[start];
+		if(b == NULL) continue;
+		// the block covers start to start + check, the write addr to addr + len
+		if((uint16_t)(addr - start) < b->check || (uint16_t)(start - addr) < len) {
+			b->valid = 0;
+			blocks->at[start] = NULL;
+			blocks->invalidated ++;
+		}
+	}
+}
+
+static void decode(struct block *b, const uint8_t *memory, uint16_t start) {
+	uint8_t opcodes[BLOCK_MAX];
+	b->start = start;
+	b->target = 0;
+	b->n = 0;
+	b->len = 0;
+	b->cycles = 0;
+	for(;;) {
+		const struct opinfo *op = &ops[memory[start + b->len]];
+		// don't run across the end of memory, or the warm boot and BDOS
+		// checks of cpm_run would be skipped
+		if(b->n > 0 && start + b->len + op->len > 0x10000) break;
+
+		opcodes[b->n ++] = memory[start + b->len];
+		b->len += op->len;
+		b->cycles += op->taken;
+		if(op->flow != FLOW_NONE || b->n == BLOCK_MAX) break;
+		// a store could change what comes next, so it ends the block too
+		if(op->access & ACC_WRITE) break;
+	}
+	idiom_match(&b->idiom, memory, start);
+	b->check = b->idiom.len > b->len ? b->idiom.len : b->len;
+
+	// where it goes when that is known
+	const uint8_t *last_op = memory + start + b->len - ops[opcodes[b->n - 1]].len;
+	b->end = ops[last_op[0]].flow;
+	if(b->end == FLOW_JUMP || b->end == FLOW_BRANCH || b->end == FLOW_CALL || b->end == FLOW_CALL_COND) {
+		b->target = last_op[1] | last_op[2] << 8;
+	}
+	if(b->end == FLOW_RST) b->target = last_op[0] & 0x38;
+
+	// the last instruction setting Z, S and P may leave them for later,
+	// unless it is POP PSW which sets them from memory, not from a result
+	int last = -1;
+	for(int i = b->n - 1;i >= 0;i --) {
+		if(ops[opcodes[i]].writes & F_Z) { last = i; break; }
+	}
+	b->defer = 0;
+	if(last >= 0 && opcodes[last] != 0xf1) {
+		uint8_t read = 0;
+		for(int i = last + 1;i < b->n;i ++) read |= ops[opcodes[i]].reads;
+		b->defer = (F_Z | F_S | F_P) & ~read;
+	}
+
+	// everything is live when the block ends
+	uint8_t live = F_ALL;
+	for(int i = b->n - 1;i >= 0;i --) {
+		const struct opinfo *op = &ops[opcodes[i]];
+		uint8_t need = op->writes & live;
+		if(i == last) need &= ~b->defer;
+		b->step[i] = execute_variant(need);
+		live = (live & ~op->writes) | op->reads;
+	}
+	b->live_in = live;
+}
+
+static struct block *translate(struct blocks *blocks, const uint8_t *memory, uint16_t pc) {
+	if(blocks->used == BLOCK_POOL) flush(blocks);
+	struct block *b = &blocks->pool[blocks->used ++];
+	memset(b->link, 0, sizeof(b->link));
+	decode(b, memory, pc);
+	b->valid = 1;
+	b->stop = blocks->stop[pc >> 3] >> (pc & 7) & 1;
+	for(uint32_t i = 0;i < b->check;i += 1 << DIRTY_SHIFT) blocks->watch.map[(uint16_t)(pc + i) >> DIRTY_SHIFT] = 1;
+	blocks->watch.map[(uint16_t)(pc + b->check - 1) >> DIRTY_SHIFT] = 1;
+	blocks->at[pc] = b;
+	blocks->translated ++;
+	return b;
+}
+
+// the block to run at pc, after prev (NULL if something else ran in
+// between). Follows prev's links when they are still good, fills them in
+// when they aren't.
+static struct block *next(struct blocks *blocks, struct block *prev, const uint8_t *memory, uint16_t pc) {
+	struct block **link = NULL;
+	if(prev) {
+		const uint16_t after = prev->start + prev->len;
+		if(prev->end == FLOW_RET || (prev->end == FLOW_RET_COND && pc != after)) {
+			// returned: the block that made the call links to where it
+			// comes back to, if the return went where it was predicted
+			if(blocks->depth > 0) {
+				const struct ret *r = &blocks->rets[-- blocks->depth % BLOCK_RETS];
+				if(r->pc == pc && r->caller->valid) link = &r->caller->link[0];
+			}
+		} else if(pc == after) {
+			link = &prev->link[0];
+		} else if(pc == prev->target) {
+			link = &prev->link[1];
+			// a call went through, remember where it comes back to
+			if(prev->end == FLOW_CALL || prev->end == FLOW_CALL_COND || prev->end == FLOW_RST) {
+				struct ret *r = &blocks->rets[blocks->depth ++ % BLOCK_RETS];
+				r->pc = after;
+				r->caller = prev;
+			}
+		}
+	}
+	if(link && *link && (*link)->valid) {
+		blocks->chained ++;
+		return *link;
+	}
+
+	struct block *b = blocks->at[pc];
+	if(b == NULL) {
+		const uint32_t flushes = blocks->flushes;
+		b = translate(blocks, memory, pc);
+		// prev is gone with the rest
+		if(flushes != blocks->flushes) return b;
+	}
+	if(link) *link = b;
+	return b;
+}
+
+void block_run(struct blocks *blocks, struct i8080 *cpu, uint8_t *memory, uint64_t until) {
+	cpu->watch = &blocks->watch;
+	struct block *prev = NULL;
+	int first = 1;
+	while(cpu->clock_cnt < until && !getFlag(cpu, HLT)) {
+		struct block *b = next(blocks, prev, memory, cpu->pc);
+		if(b->stop && !first) return;
+		first = 0;
+
+		if(b->idiom.kind != IDIOM_NONE) {
+			flags_flush(cpu);
+			if(idiom_run(&b->idiom, cpu, memory, until)) {
+				prev = NULL;
+				continue;
+			}
+		}
+
+		// run a single instruction when the block doesn't fit, so that
+		// until is met exactly
+		if(cpu->clock_cnt + b->cycles > until) {
+			flags_flush(cpu);
+			execute_instruction(cpu, memory);
+			prev = NULL;
+			continue;
+		}
+
+		if(cpu->deferred & b->live_in) flags_flush(cpu);
+		// any deferred flag not flushed is set again in here
+		for(int i = 0;i < b->n;i ++) b->step[i](cpu, memory);
+		cpu->deferred = b->defer;
+		prev = b;
+	}
+}
@@ -0,0 +1,58 @@
+#include <stdint.h> // uint8_t, uint16_t, uint64_t
+#include <stdio.h> // FILE
+
+struct i8080;
+
+// Runs code a block at a time instead of an instruction at a time. A block
+// is decoded once, when it is first reached, and kept until its code is
+// written to: up to BLOCK_MAX instructions from its start, ending after the
+// first jump, call, return, RST, PCHL or HLT, or after the first store,
+// which might rewrite the rest of it.
+//
+// Blocks are chained: each remembers the blocks that ran after it, so that
+// going from one to the next is a compare instead of a lookup. A block the
+// CPU writes over is dropped (through cpu->watch), links to it are let go
+// of the next time they are followed. RET is predicted with a small stack
+// of the calls made: the block that made a call links to the one it comes
+// back to.
+//
+// What the decoding buys is flag liveness. Going backwards through the
+// block with the flags read and written from ops.h, an instruction only
+// has to compute the flags that somebody reads before they are written
+// again, so every one gets the interpreter variant with just those
+// (execute_variant). Flags still live at the end of the block are computed,
+// except that Z, S and P of the last instruction setting them are only
+// deferred (cpu->deferred): the next block works them out if it reads them
+// before setting them. That is what makes DCR B; JNZ loops cheap.
+//
+// Copy and fill loops are spotted when their first block is decoded and
+// run natively instead (idiom.h).
+//
+// The flags in cpu->flags can be stale while running, call flags_flush
+// before looking at them from outside. The same goes for the flags of the
+// flight recorder.
+
+#define BLOCK_MAX 32 // instructions
+#define BLOCK_BYTES (BLOCK_MAX * 3)
+#define BLOCK_POOL 4096 // blocks kept at most, all are dropped when it runs out
+#define BLOCK_RETS 16 // calls remembered for predicting returns
+
+struct blocks;
+
+// NULL if out of memory
+struct blocks *blocks_create(void);
+void blocks_destroy(struct blocks *blocks);
+
+// block_run returns instead of running the code at addr, to let the caller
+// handle it
+void block_stop(struct blocks *blocks, uint16_t addr);
+
+// run blocks from cpu->pc until the clock reaches until, the CPU halts or
+// pc gets to a block_stop address (other than the one it starts at). A
+// block that could take the clock past until is done an instruction at a
+// time, with the flags flushed, so that whoever raises interrupts at until
+// sees exact timing. Points cpu->watch at blocks.
+void block_run(struct blocks *blocks, struct i8080 *cpu, uint8_t *memory, uint64_t until);
+
+// how many blocks were decoded, dropped and chained to
+void blocks_report(FILE *f, const struct blocks *blocks);
@@ -0,0 +1,145 @@
+#include <stdio.h> // snprintf, fprintf
+#include <stdlib.h> // calloc
+#include <string.h> // strlen
+#include <errno.h> // EINTR
+#include <fcntl.h> // open
+#include <signal.h> // signal
+#include <unistd.h> // write, close
+#include <sys/uio.h> // writev
+
+#include "capture.h"
+
+#define BATCH 16 // frames per writev
+
+// writes all of iov, or returns -1
+static int write_all(int fd, struct iovec *iov, int count) {
+	while(count > 0) {
+		ssize_t n = writev(fd, iov, count);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return -1;
+
+		while(count > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov ++;
+			count --;
+		}
+		if(count > 0) {
+			iov->iov_base = (uint8_t *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+// VRAM to an upright 8 bit picture
+static void to_plane(const uint8_t *vram, uint8_t *plane) {
+	for(int x = 0;x < FB_WIDTH;x ++) {
+		const uint8_t *col = vram + x * FB_COLUMN;
+		for(int i = 0;i < FB_HEIGHT;i ++) {
+			plane[(FB_HEIGHT - 1 - i) * FB_WIDTH + x] = (col[i / 8] >> (i % 8)) & 1 ? 255 : 0;
+		}
+	}
+}
+
+// writes out every queued frame, returns -1 on a write error
+static int drain(struct capture *c) {
+	const uint32_t head = atomic_load_explicit(&c->head, memory_order_acquire);
+	uint32_t tail = atomic_load_explicit(&c->tail, memory_order_relaxed);
+
+	while(tail != head) {
+		struct iovec iov[2 * BATCH];
+		int n = 0, frames = 0;
+
+		if(c->format == CAPTURE_RAW) {
+			// raw frames go out of the slots as they are, a batch at a time
+			while(tail + frames != head && frames < BATCH) {
+				iov[n].iov_base = c->slot[(tail + frames) & (CAPTURE_SLOTS - 1)];
+				iov[n].iov_len = FB_BYTES;
+				n ++;
+				frames ++;
+			}
+		} else {
+			static char header[] = "FRAME\n";
+			to_plane(c->slot[tail & (CAPTURE_SLOTS - 1)], c->plane);
+			iov[n ++] = (struct iovec){header, strlen(header)};
+			iov[n ++] = (struct iovec){c->plane, sizeof(c->plane)};
+			frames = 1;
+		}
+
+		if(write_all(c->fd, iov, n) != 0) return -1;
+		tail += frames;
+		c->written += frames;
+		atomic_store_explicit(&c->tail, tail, memory_order_release);
+	}
+	return 0;
+}
+
+static void *writer(void *arg) {
+	struct capture *c = arg;
+	while(1) {
+		while(sem_wait(&c->ready) != 0 && errno == EINTR);
+		if(drain(c) != 0) {
+			atomic_store(&c->failed, 1);
+			break;
+		}
+		if(atomic_load(&c->closing)) break;
+	}
+	return NULL;
+}
+
+struct capture *capture_open(const char *path, enum capture_format format, int fps) {
+	struct capture *c = calloc(1, sizeof(struct capture));
+	if(c == NULL) return NULL;
+	memset(c->slot, 0, sizeof(c->slot)); // fault the pool in now, not during the first frames
+
+	c->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(c->fd < 0) {
+		free(c);
+		return NULL;
+	}
+
+	// a reader on the other end of a pipe going away should end the
+	// capture, not the emulator
+	signal(SIGPIPE, SIG_IGN);
+
+	char header[128];
+	if(format == CAPTURE_RAW) snprintf(header, sizeof(header), "INVADERS-1BPP W%d H%d F%d\n", FB_WIDTH, FB_HEIGHT, fps);
+	else snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono\n", FB_WIDTH, FB_HEIGHT, fps);
+	struct iovec iov = {header, strlen(header)};
+	c->format = format;
+	atomic_init(&c->failed, write_all(c->fd, &iov, 1) != 0);
+	atomic_init(&c->head, 0);
+	atomic_init(&c->tail, 0);
+	atomic_init(&c->closing, 0);
+	sem_init(&c->ready, 0, 0);
+	pthread_create(&c->writer, NULL, writer, c);
+	return c;
+}
+
+void capture_close(struct capture *c) {
+	atomic_store(&c->closing, 1);
+	sem_post(&c->ready);
+	pthread_join(c->writer, NULL);
+
+	fprintf(stderr, "Capture: %llu frames written, %llu dropped%s\n",
+			(unsigned long long)c->written, (unsigned long long)c->dropped,
+			atomic_load(&c->failed) ? ", stopped by a write error" : "");
+	sem_destroy(&c->ready);
+	close(c->fd);
+	free(c);
+}
+
+uint8_t *capture_frame(struct capture *c) {
+	const uint32_t head = atomic_load_explicit(&c->head, memory_order_relaxed);
+	const uint32_t tail = atomic_load_explicit(&c->tail, memory_order_acquire);
+	if(atomic_load_explicit(&c->failed, memory_order_relaxed) || head - tail == CAPTURE_SLOTS) {
+		c->dropped ++;
+		return NULL;
+	}
+	return c->slot[head & (CAPTURE_SLOTS - 1)];
+}
+
+void capture_submit(struct capture *c) {
+	atomic_store_explicit(&c->head, atomic_load_explicit(&c->head, memory_order_relaxed) + 1, memory_order_release);
+	sem_post(&c->ready);
+}
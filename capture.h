@@ -0,0 +1,51 @@
+#include <stdint.h> // uint8_t, uint32_t, uint64_t
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "fb.h"
+
+// Records the screen to a file or pipe from a thread of its own.
+//
+// Frames are put together straight in a ring of preallocated VRAM sized
+// slots and the writer thread writes them out from there. The emulator
+// never waits for it: when all the slots are taken the frame is dropped.
+//
+// Formats:
+//  raw - a header line "INVADERS-1BPP W224 H256 F60\n", then every frame as
+//        the FB_BYTES of VRAM, columns left to right, each one bottom to
+//        top, lowest bit first. About 7 KB a frame.
+//  y4m - YUV4MPEG2 with Cmono, one byte per pixel, for ffmpeg and friends.
+
+#define CAPTURE_SLOTS 64 // must be a power of two
+
+enum capture_format {
+	CAPTURE_RAW,
+	CAPTURE_Y4M,
+};
+
+struct capture {
+	int fd;
+	enum capture_format format;
+	uint8_t slot[CAPTURE_SLOTS][FB_BYTES];
+	atomic_uint head, tail; // frames submitted / written, wrap around
+	sem_t ready; // posted for every submitted frame
+	atomic_int closing;
+	pthread_t writer;
+
+	uint8_t plane[FB_WIDTH * FB_HEIGHT]; // y4m frame, only touched by the writer
+	uint64_t written, dropped;
+	atomic_int failed; // the writer gave up, e.g. the pipe was closed
+};
+
+// fps is only used for the header. Returns NULL if path can't be opened.
+struct capture *capture_open(const char *path, enum capture_format format, int fps);
+
+// finishes writing what is queued, closes the file and says how it went
+// on stderr
+void capture_close(struct capture *capture);
+
+// the slot for the next frame, or NULL if the writer is behind and this
+// frame has to be dropped. Fill it with VRAM, then call capture_submit.
+uint8_t *capture_frame(struct capture *capture);
+void capture_submit(struct capture *capture);
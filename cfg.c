@@ -0,0 +1,388 @@
+#include <stdlib.h> // calloc, realloc
+#include <string.h> // memset
+
+#include "cfg.h"
+#include "dis.h"
+#include "ops.h"
+
+// what the traversal found out about each address
+#define MARK_START  (1 << 0) // an instruction starts here
+#define MARK_BODY   (1 << 1) // operand bytes
+#define MARK_LEADER (1 << 2) // a block starts here
+#define MARK_ENTRY  (1 << 3)
+#define MARK_CALLED (1 << 4)
+#define MARK_TABLE  (1 << 5) // part of a jump table
+
+#define ORDINARY -1 // doesn't end a block
+
+struct table {
+	uint16_t pchl; // address of the PCHL
+	uint16_t addr;
+	uint16_t count;
+};
+
+struct walk {
+	const uint8_t *image;
+	uint16_t origin;
+	uint32_t size;
+	uint8_t *mark; // 64K
+	uint16_t *todo; // addresses still to be decoded
+	uint32_t ntodo, todo_cap;
+	struct table *tables;
+	uint32_t ntables;
+};
+
+static int inside(const struct walk *w, uint16_t addr) {
+	return (uint16_t)(addr - w->origin) < w->size || w->size > 0xFFFF;
+}
+
+static uint8_t byte(const struct walk *w, uint16_t addr) {
+	return w->image[(uint16_t)(addr - w->origin)];
+}
+
+static uint16_t word(const struct walk *w, uint16_t addr) {
+	return byte(w, addr) | byte(w, addr + 1) << 8;
+}
+
+static int push(struct walk *w, uint16_t addr, uint8_t mark) {
+	if(!inside(w, addr)) return 0;
+	w->mark[addr] |= MARK_LEADER | mark;
+
+	if(w->ntodo == w->todo_cap) {
+		const uint32_t cap = w->todo_cap ? w->todo_cap * 2 : 256;
+		uint16_t *grown = realloc(w->todo, cap * sizeof(uint16_t));
+		if(grown == NULL) return -1;
+		w->todo = grown;
+		w->todo_cap = cap;
+	}
+	w->todo[w->ntodo ++] = addr;
+	return 0;
+}
+
+static const uint8_t flow[256] = {
+#define X(op, fmt, len, cycles, taken, reads, writes, access, fl) [op] = fl,
+	OPCODES(X)
+#undef X
+};
+
+static int classify(uint8_t op) {
+	switch(flow[op]) {
+		case FLOW_JUMP: return CFG_JUMP;
+		case FLOW_BRANCH: return CFG_BRANCH;
+		case FLOW_CALL:
+		case FLOW_CALL_COND:
+		case FLOW_RST: return CFG_CALL;
+		case FLOW_RET: return CFG_RET;
+		case FLOW_RET_COND: return CFG_RET_COND;
+		case FLOW_INDIRECT: return CFG_INDIRECT;
+		case FLOW_HALT: return CFG_HALT;
+		case FLOW_INVALID: return CFG_INVALID;
+		default: return ORDINARY;
+	}
+}
+
+// where a CALL, Ccc or RST goes
+static uint16_t call_target(const struct walk *w, uint16_t addr) {
+	const uint8_t op = byte(w, addr);
+	if(flow[op] == FLOW_RST) return op & 0x38;
+	return word(w, addr + 1);
+}
+
+// guess the jump table of the PCHL at pchl from the last LXI H or LXI D
+// before it, and queue its targets
+static int table(struct walk *w, uint16_t pchl, int lxi) {
+	if(lxi < 0) return 0;
+	const uint16_t addr = word(w, lxi + 1);
+
+	uint16_t count = 0;
+	while(count < CFG_MAX_TABLE) {
+		const uint16_t at = addr + count * 2;
+		if(!inside(w, at) || !inside(w, at + 1)) break;
+		if((w->mark[at] | w->mark[(uint16_t)(at + 1)]) & (MARK_START | MARK_BODY)) break;
+		if(!inside(w, word(w, at))) break;
+		count ++;
+	}
+	if(count == 0) return 0;
+
+	struct table *grown = realloc(w->tables, (w->ntables + 1) * sizeof(struct table));
+	if(grown == NULL) return -1;
+	w->tables = grown;
+	w->tables[w->ntables ++] = (struct table){pchl, addr, count};
+
+	for(uint16_t i = 0;i < count;i ++) {
+		const uint16_t at = addr + i * 2;
+		w->mark[at] |= MARK_TABLE;
+		w->mark[(uint16_t)(at + 1)] |= MARK_TABLE;
+		if(push(w, word(w, at), 0) != 0) return -1;
+	}
+	return 0;
+}
+
+// decode from addr until the flow leaves the straight line
+static int run(struct walk *w, uint16_t addr) {
+	int lxi = -1; // the last LXI H or LXI D, for PCHL
+	while(inside(w, addr) && (w->mark[addr] & (MARK_START | MARK_BODY)) == 0) {
+		const uint8_t op = byte(w, addr);
+		const int size = lookup[op].size;
+
+		// an operand that runs off the image or into another instruction
+		// leaves the block as it is, cfg_analyze marks it invalid
+		for(int i = 1;i < size;i ++) {
+			const uint16_t at = addr + i;
+			if(!inside(w, at) || (w->mark[at] & MARK_START)) return 0;
+		}
+
+		w->mark[addr] |= MARK_START;
+		for(int i = 1;i < size;i ++) w->mark[(uint16_t)(addr + i)] |= MARK_BODY;
+
+		const uint16_t next = addr + size;
+		switch(classify(op)) {
+			case ORDINARY:
+				if(op == 0x21 || op == 0x11) lxi = addr;
+				addr = next;
+				continue;
+			case CFG_JUMP:
+				return push(w, word(w, addr + 1), 0);
+			case CFG_BRANCH:
+				if(push(w, word(w, addr + 1), 0) != 0) return -1;
+				return push(w, next, 0);
+			case CFG_CALL:
+				if(push(w, call_target(w, addr), MARK_CALLED) != 0) return -1;
+				return push(w, next, 0);
+			case CFG_RET_COND:
+			case CFG_HALT:
+				return push(w, next, 0);
+			case CFG_INDIRECT:
+				return table(w, addr, lxi);
+			default:
+				return 0;
+		}
+	}
+	return 0;
+}
+
+static const struct table *find_table(const struct walk *w, uint16_t pchl) {
+	for(uint32_t i = 0;i < w->ntables;i ++) {
+		if(w->tables[i].pchl == pchl) return &w->tables[i];
+	}
+	return NULL;
+}
+
+static int add_succ(struct cfg *cfg, struct cfg_block *b, const struct walk *w, uint16_t addr, uint32_t *cap) {
+	if(inside(w, addr) && !(w->mark[addr] & MARK_START)) b->flags |= CFG_OVERLAP;
+
+	if(cfg->nsucc == *cap) {
+		*cap = *cap ? *cap * 2 : 256;
+		uint16_t *grown = realloc(cfg->succ, *cap * sizeof(uint16_t));
+		if(grown == NULL) return -1;
+		cfg->succ = grown;
+	}
+	cfg->succ[cfg->nsucc ++] = addr;
+	b->nsucc ++;
+	return 0;
+}
+
+// finish the block whose last instruction is at last
+static int close_block(struct cfg *cfg, struct cfg_block *b, const struct walk *w, uint16_t last, int end, uint32_t *cap) {
+	const uint8_t op = byte(w, last);
+	const uint16_t next = last + lookup[op].size;
+	b->len = (uint16_t)(next - b->start);
+	if(b->len == 0) b->len = 0x10000; // the whole address space
+	b->succ = cfg->nsucc;
+
+	// the straight line stopped without a branch
+	if(end == ORDINARY) {
+		end = inside(w, next) && (w->mark[next] & MARK_START) ? CFG_FALL : CFG_INVALID;
+		if(inside(w, next) && (w->mark[next] & MARK_BODY)) b->flags |= CFG_OVERLAP;
+	}
+
+	int err = 0;
+	switch(end) {
+		case CFG_FALL:
+		case CFG_RET_COND:
+		case CFG_HALT:
+			err = add_succ(cfg, b, w, next, cap);
+			break;
+		case CFG_JUMP:
+			err = add_succ(cfg, b, w, word(w, last + 1), cap);
+			break;
+		case CFG_BRANCH:
+			err = add_succ(cfg, b, w, word(w, last + 1), cap);
+			if(!err) err = add_succ(cfg, b, w, next, cap);
+			break;
+		case CFG_CALL:
+			b->target = call_target(w, last);
+			if(inside(w, b->target) && !(w->mark[b->target] & MARK_START)) b->flags |= CFG_OVERLAP;
+			err = add_succ(cfg, b, w, next, cap);
+			break;
+		case CFG_INDIRECT: {
+			const struct table *t = find_table(w, last);
+			if(t == NULL) break;
+			end = CFG_TABLE;
+			for(uint16_t i = 0;i < t->count && !err;i ++) {
+				// code found later may have cut the table short
+				const uint16_t at = t->addr + i * 2;
+				if((w->mark[at] | w->mark[(uint16_t)(at + 1)]) & (MARK_START | MARK_BODY)) break;
+				err = add_succ(cfg, b, w, word(w, at), cap);
+			}
+			break;
+		}
+		default: break;
+	}
+	b->end = end;
+	return err;
+}
+
+static int build(struct cfg *cfg, const struct walk *w) {
+	uint32_t cap_blocks = 0, cap_succ = 0;
+	struct cfg_block *b = NULL;
+	for(uint32_t i = 0;i < w->size;) {
+		const uint16_t addr = w->origin + i;
+		const uint8_t m = w->mark[addr];
+		if(!(m & MARK_START)) {
+			i ++;
+			continue;
+		}
+
+		if(b == NULL || (m & MARK_LEADER)) {
+			if(cfg->nblocks == cap_blocks) {
+				cap_blocks = cap_blocks ? cap_blocks * 2 : 256;
+				struct cfg_block *grown = realloc(cfg->blocks, cap_blocks * sizeof(struct cfg_block));
+				if(grown == NULL) return -1;
+				cfg->blocks = grown;
+			}
+			b = &cfg->blocks[cfg->nblocks ++];
+			memset(b, 0, sizeof(struct cfg_block));
+			b->start = addr;
+			if(m & MARK_ENTRY) b->flags |= CFG_ENTRY;
+			if(m & MARK_CALLED) b->flags |= CFG_CALLED;
+		}
+
+		const uint8_t op = byte(w, addr);
+		const uint16_t next = addr + lookup[op].size;
+		const int end = classify(op);
+		// a block also ends where the next one starts, or where decoding stopped
+		if(end != ORDINARY || !inside(w, next) || !(w->mark[next] & MARK_START) || (w->mark[next] & MARK_LEADER)) {
+			if(close_block(cfg, b, w, addr, end, &cap_succ) != 0) return -1;
+			b = NULL;
+		}
+		i += lookup[op].size;
+	}
+	return 0;
+}
+
+static int regions(struct cfg *cfg, const struct walk *w) {
+	uint32_t cap = 0;
+	int kind = -1;
+	for(uint32_t i = 0;i < w->size;i ++) {
+		const uint8_t m = w->mark[(uint16_t)(w->origin + i)];
+		int k = CFG_DATA;
+		if(m & (MARK_START | MARK_BODY)) k = CFG_CODE;
+		else if(m & MARK_TABLE) k = CFG_JUMP_TABLE;
+
+		if(k == kind) {
+			cfg->regions[cfg->nregions - 1].len ++;
+			continue;
+		}
+		if(cfg->nregions == cap) {
+			cap = cap ? cap * 2 : 64;
+			struct cfg_region *grown = realloc(cfg->regions, cap * sizeof(struct cfg_region));
+			if(grown == NULL) return -1;
+			cfg->regions = grown;
+		}
+		cfg->regions[cfg->nregions ++] = (struct cfg_region){w->origin + i, 1, k};
+		kind = k;
+	}
+	return 0;
+}
+
+struct cfg *cfg_analyze(const uint8_t *image, uint16_t origin, uint32_t size, const uint16_t *entries, uint32_t nentries) {
+	// the image stops at 0xFFFF rather than wrapping around, so that the
+	// blocks come out in address order
+	if(size > 0x10000 - origin) size = 0x10000 - origin;
+	struct walk w = {image, origin, size, calloc(0x10000, 1), NULL, 0, 0, NULL, 0};
+	struct cfg *cfg = calloc(1, sizeof(struct cfg));
+	if(w.mark == NULL || cfg == NULL) goto fail;
+	cfg->origin = origin;
+	cfg->size = size;
+
+	// the origin, reset, the RST vectors, then the rest
+	cfg->entries = malloc((nentries + 9) * sizeof(uint16_t));
+	if(cfg->entries == NULL) goto fail;
+	const uint16_t fixed[9] = {origin, 0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38};
+	for(uint32_t i = 0;i < nentries + 9;i ++) {
+		const uint16_t addr = i < 9 ? fixed[i] : entries[i - 9];
+		if(!inside(&w, addr) || (w.mark[addr] & MARK_ENTRY)) continue;
+		w.mark[addr] |= MARK_ENTRY;
+		cfg->entries[cfg->nentries ++] = addr;
+	}
+	// backwards, so that the origin is followed first
+	for(uint32_t i = cfg->nentries;i > 0;i --) {
+		if(push(&w, cfg->entries[i - 1], 0) != 0) goto fail;
+	}
+
+	while(w.ntodo > 0) {
+		if(run(&w, w.todo[-- w.ntodo]) != 0) goto fail;
+	}
+	if(build(cfg, &w) != 0 || regions(cfg, &w) != 0) goto fail;
+
+	free(w.mark);
+	free(w.todo);
+	free(w.tables);
+	return cfg;
+
+fail:
+	free(w.mark);
+	free(w.todo);
+	free(w.tables);
+	cfg_free(cfg);
+	return NULL;
+}
+
+void cfg_free(struct cfg *cfg) {
+	if(cfg == NULL) return;
+	free(cfg->blocks);
+	free(cfg->succ);
+	free(cfg->regions);
+	free(cfg->entries);
+	free(cfg);
+}
+
+static void put16(FILE *f, uint16_t v) {
+	fputc(v & 0xFF, f);
+	fputc(v >> 8, f);
+}
+
+static void put32(FILE *f, uint32_t v) {
+	put16(f, v & 0xFFFF);
+	put16(f, v >> 16);
+}
+
+int cfg_write(const struct cfg *cfg, FILE *f) {
+	fwrite("8080CFG1", 1, 8, f);
+	put16(f, cfg->origin);
+	put32(f, cfg->size);
+	put32(f, cfg->nentries);
+	put32(f, cfg->nblocks);
+	put32(f, cfg->nsucc);
+	put32(f, cfg->nregions);
+
+	for(uint32_t i = 0;i < cfg->nentries;i ++) put16(f, cfg->entries[i]);
+	for(uint32_t i = 0;i < cfg->nblocks;i ++) {
+		const struct cfg_block *b = &cfg->blocks[i];
+		put16(f, b->start);
+		put32(f, b->len);
+		fputc(b->end, f);
+		fputc(b->flags, f);
+		put16(f, b->nsucc);
+		put32(f, b->succ);
+		put16(f, b->target);
+	}
+	for(uint32_t i = 0;i < cfg->nsucc;i ++) put16(f, cfg->succ[i]);
+	for(uint32_t i = 0;i < cfg->nregions;i ++) {
+		put16(f, cfg->regions[i].start);
+		put32(f, cfg->regions[i].len);
+		fputc(cfg->regions[i].kind, f);
+	}
+	return ferror(f) ? -1 : 0;
+}
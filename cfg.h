@@ -0,0 +1,87 @@
+#include <stdint.h> // uint8_t, uint16_t, uint32_t
+#include <stdio.h> // FILE
+
+// Control flow graph of a program image, found by recursive traversal:
+// starting from the entry points, only bytes that execution can actually
+// reach are decoded, following JMP, Jcc, CALL, Ccc, RST, RET and PCHL.
+// Whatever is never reached is data.
+//
+// PCHL jumps through a table now and then. When the block that does it
+// loaded a table address with LXI H or LXI D, the words there are taken as
+// targets for as long as they point into the image. That is a guess, the
+// block is marked CFG_TABLE so that nobody relies on it blindly.
+
+#define CFG_MAX_TABLE 64 // entries of a jump table at most
+
+// how a block ends
+enum cfg_end {
+	CFG_FALL,     // runs into the next block
+	CFG_JUMP,     // JMP
+	CFG_BRANCH,   // Jcc, taken or falls through
+	CFG_CALL,     // CALL, Ccc or RST, assumed to come back
+	CFG_RET,      // RET
+	CFG_RET_COND, // Rcc, returns or falls through
+	CFG_INDIRECT, // PCHL, target unknown
+	CFG_TABLE,    // PCHL through a jump table
+	CFG_HALT,     // HLT, an interrupt carries on after it
+	CFG_INVALID,  // undefined opcode, or it runs off the image
+};
+
+// block flags
+#define CFG_ENTRY   (1 << 0) // one of the entry points
+#define CFG_CALLED  (1 << 1) // a CALL or RST goes here
+#define CFG_OVERLAP (1 << 2) // it or a jump out of it runs into the middle of an instruction
+
+struct cfg_block {
+	uint16_t start;
+	uint32_t len; // bytes, the last instruction included
+	uint8_t end; // enum cfg_end
+	uint8_t flags;
+	uint16_t nsucc;
+	uint32_t succ; // index of the first successor in cfg->succ
+	uint16_t target; // where a call or RST goes, not a successor
+};
+
+// what a byte of the image is
+enum cfg_kind {
+	CFG_DATA,       // never reached, so it is not code as far as we know
+	CFG_CODE,       // part of an instruction
+	CFG_JUMP_TABLE, // the targets of a CFG_TABLE block
+};
+
+struct cfg_region {
+	uint16_t start;
+	uint32_t len;
+	uint8_t kind; // enum cfg_kind
+};
+
+struct cfg {
+	uint16_t origin; // where the image is loaded
+	uint32_t size;
+
+	struct cfg_block *blocks; // sorted by address
+	uint32_t nblocks;
+	uint16_t *succ; // successors of all blocks, addresses
+	uint32_t nsucc;
+	struct cfg_region *regions; // the whole image, in order
+	uint32_t nregions;
+	uint16_t *entries;
+	uint32_t nentries;
+};
+
+// analyze size bytes of code loaded at origin, whatever would go past 0xFFFF
+// is left out. The origin, reset and the RST vectors that lie inside the
+// image are always entry points, entries adds more. A jump into the middle
+// of an instruction is not followed, the block it comes from is marked
+// CFG_OVERLAP. NULL if out of memory.
+struct cfg *cfg_analyze(const uint8_t *image, uint16_t origin, uint32_t size, const uint16_t *entries, uint32_t nentries);
+void cfg_free(struct cfg *cfg);
+
+// The file format, everything little endian:
+//   "8080CFG1", origin u16, size u32, nentries u32, nblocks u32, nsucc u32, nregions u32
+//   entries:  u16 each
+//   blocks:   start u16, len u32, end u8, flags u8, nsucc u16, succ u32, target u16
+//   succ:     u16 each
+//   regions:  start u16, len u32, kind u8
+// Returns 0 or -1.
+int cfg_write(const struct cfg *cfg, FILE *f);
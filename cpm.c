@@ -0,0 +1,129 @@
+#include <stdio.h> // fprintf
+#include <stdlib.h> // realloc
+#include <string.h> // memcpy
+#include <unistd.h> // write
+
+#include "8080.h"
+#include "cpm.h"
+#include "block.h"
+
+void cpm_flush(struct cpm *cpm) {
+	if(cpm->fd < 0) {
+		// keep it NUL terminated so that it can be searched with strstr
+		char *grown = realloc(cpm->capture, cpm->capture_len + cpm->out_len + 1);
+		if(grown != NULL) {
+			cpm->capture = grown;
+			memcpy(cpm->capture + cpm->capture_len, cpm->out, cpm->out_len);
+			cpm->capture_len += cpm->out_len;
+			cpm->capture[cpm->capture_len] = '\0';
+		}
+		cpm->out_len = 0;
+		return;
+	}
+
+	size_t done = 0;
+	while(done < cpm->out_len) {
+		const ssize_t n = write(cpm->fd, cpm->out + done, cpm->out_len - done);
+		if(n <= 0) break;
+		done += n;
+	}
+	cpm->out_len = 0;
+}
+
+static void putch(struct cpm *cpm, char c) {
+	if(cpm->out_len == sizeof(cpm->out)) cpm_flush(cpm);
+	cpm->out[cpm->out_len ++] = c;
+}
+
+void cpm_setup(uint8_t *memory) {
+	// warm boot vector - we never run it, reaching 0 ends the program
+	memory[0] = 0xc3; // JMP
+	memory[1] = 0x03;
+	memory[2] = 0xff;
+
+	// BDOS entry, programs also read 6-7 to find the top of usable memory
+	memory[5] = 0xc3; // JMP
+	memory[6] = CPM_BDOS & 0xFF;
+	memory[7] = CPM_BDOS >> 8;
+	memory[CPM_BDOS] = 0xc9; // RET, in case somebody jumps there directly
+}
+
+void cpm_init(struct cpm *cpm, struct i8080 *cpu, uint8_t *memory, int fd) {
+	cpm->fd = fd;
+	cpm->status = CPM_RUNNING;
+	cpm->cycle_limit = 0;
+	cpm->profile = NULL;
+	cpm->blocks = NULL;
+	cpm->capture = NULL;
+	cpm->capture_len = 0;
+	cpm->out_len = 0;
+
+	// the CCP calls into the program, so a plain RET also exits
+	cpu->sp = CPM_BDOS - 2;
+	memory[cpu->sp] = 0;
+	memory[cpu->sp + 1] = 0;
+	cpu->pc = CPM_TPA;
+}
+
+void cpm_free(struct cpm *cpm) {
+	free(cpm->capture);
+	cpm->capture = NULL;
+	cpm->capture_len = 0;
+}
+
+void cpm_bdos(struct cpm *cpm, struct i8080 *cpu, uint8_t *memory) {
+	switch(cpu->C) {
+		case 0: // system reset
+			cpm->status = CPM_EXIT;
+			return;
+		case 2: // console output
+			putch(cpm, cpu->E);
+			break;
+		case 9: { // print string terminated by '$'
+			uint16_t addr = rpDE(cpu);
+			// bail out after 64K in case there is no '$'
+			for(int i = 0;i < 0x10000 && memory[addr] != '$';i ++) putch(cpm, memory[addr ++]);
+			break;
+		}
+		default:
+			cpm_flush(cpm);
+			fprintf(stderr, "Unsupported BDOS function %d, pc=%04x\n", cpu->C,
+					memory[cpu->sp] | memory[cpu->sp + 1] << 8);
+			cpm->status = CPM_BAD_CALL;
+			return;
+	}
+
+	// return to the caller as if the BDOS had executed a RET
+	cpu->pc = memory[cpu->sp] | memory[cpu->sp + 1] << 8;
+	cpu->sp += 2;
+}
+
+int cpm_run(struct cpm *cpm, struct i8080 *cpu, uint8_t *memory) {
+	const uint64_t limit = cpm->cycle_limit ? cpm->cycle_limit : UINT64_MAX;
+	if(cpm->blocks) {
+		block_stop(cpm->blocks, 0);
+		block_stop(cpm->blocks, 5);
+	}
+	while(cpm->status == CPM_RUNNING) {
+		if(cpu->clock_cnt >= limit) { cpm->status = CPM_TIMEOUT; break; }
+
+		// one compare catches both the warm boot and the BDOS entry
+		if(cpu->pc <= 5) {
+			if(cpu->pc == 0) { cpm->status = CPM_EXIT; break; }
+			if(cpu->pc == 5) { cpm_bdos(cpm, cpu, memory); continue; }
+		}
+
+		if(cpm->blocks && !cpm->profile) {
+			// comes back here for the warm boot, the BDOS or the limit
+			block_run(cpm->blocks, cpu, memory, limit);
+		} else {
+			if(cpm->profile) cpm->profile[memory[cpu->pc]] ++;
+			execute_instruction(cpu, memory);
+		}
+		if(getFlag(cpu, HLT)) cpm->status = CPM_HALTED;
+	}
+	flags_flush(cpu);
+
+	cpm_flush(cpm);
+	return cpm->status;
+}
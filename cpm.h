@@ -0,0 +1,49 @@
+#include <stdint.h> // uint8_t, uint16_t
+#include <stddef.h> // size_t
+
+struct i8080;
+
+// Just enough of CP/M 2.2 to run .COM programs like cpudiag.
+// Calls to the BDOS (CALL 5) are trapped and handled natively instead of
+// running any guest code, and jumping to 0 (warm boot) ends the program.
+
+#define CPM_TPA  0x100  // .COM files are loaded and started here
+#define CPM_BDOS 0xFE00 // top of the TPA, what programs find at address 6
+
+enum cpm_status {
+	CPM_RUNNING = -1,
+	CPM_EXIT = 0,     // program did a warm boot
+	CPM_HALTED = 1,   // program executed HLT
+	CPM_BAD_CALL = 2, // program called a BDOS function we don't have
+	CPM_TIMEOUT = 3,  // ran past cycle_limit
+};
+
+struct cpm {
+	int fd; // console output, -1 to collect it in capture instead
+	int status;
+	uint64_t cycle_limit; // 0 means run forever
+	uint64_t *profile; // optional, 256 counters, executions of every opcode
+	struct blocks *blocks; // optional, run a block at a time (block.h), not with profile
+
+	char *capture; // everything the program printed, when fd is -1
+	size_t capture_len;
+
+	size_t out_len;
+	char out[4096];
+};
+
+#define CPM_MAX_COM (CPM_BDOS - CPM_TPA) // biggest .COM that fits below the BDOS
+
+// set up the zero page and the BDOS entry, the .COM goes to CPM_TPA
+void cpm_setup(uint8_t *memory);
+
+void cpm_init(struct cpm *cpm, struct i8080 *cpu, uint8_t *memory, int fd);
+void cpm_free(struct cpm *cpm);
+
+// handle a call to the BDOS, cpu->pc must be 5
+void cpm_bdos(struct cpm *cpm, struct i8080 *cpu, uint8_t *memory);
+
+// run until the program exits, returns one of enum cpm_status
+int cpm_run(struct cpm *cpm, struct i8080 *cpu, uint8_t *memory);
+
+void cpm_flush(struct cpm *cpm);
@@ -1,9 +1,7 @@
-#include <sys/stat.h> // fstat
-#include <fcntl.h> // open
-#include <sys/mman.h> // mmap
 
 #include "8080.h"
 #include "other.h"
+#include "mem.h"
 
 void debugp(struct i8080* cpu, char* buff) {
 	char flags[] = ".....";
@@ -29,7 +27,7 @@ void debugp_other(struct State8080* cpu, char* buff) {
 			cpu->a, cpu->b, cpu->c, cpu->d, cpu->e, cpu->h, cpu->l, cpu->pc, cpu->sp, flags);
 }
 
-void out(uint8_t port, uint8_t data) {
+void out(void *ctx, uint8_t port, uint8_t data) {
 	printf("OUT on port %02x: %02x\n", port, data);
 }
 
@@ -39,42 +37,40 @@ int main(int argc, char** argv) {
 		return 1;
 	}
 
-	const int fd = open(argv[1], O_RDONLY);
+	struct i8080 cpu;
+	memset(&cpu, 0, sizeof(struct i8080));
 
-	if(fd < 0) {
-		printf("Failed to open %s\n", argv[1]);
-		return 1;
-	}
+	static struct ports ports;
+	for(int i = 0;i < 256;i ++) ports.out[i] = out;
+	cpu.ports = &ports;
 
-	struct stat sb;
-	if(fstat(fd, &sb) == -1) {
-		printf("Couldn't get file size of %s\n", argv[1]);
+	// both CPUs get a writable copy of the ROM, the other emulator doesn't
+	// protect it either
+	uint8_t* memory = mem_create();
+	if(memory == NULL) {
+		printf("Out of memory\n");
 		return 1;
 	}
-
-	unsigned char* bytecode = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-	if(bytecode == MAP_FAILED) {
-		printf("Couldn't mmap %s\n", argv[1]);
+	if(mem_load(memory, argv[1], 0, 1) < 0) {
+		printf("Failed to load %s\n", argv[1]);
 		return 1;
 	}
 
-	struct i8080 cpu;
-	memset(&cpu, 0, sizeof(struct i8080));
-
-	uint8_t* memory = calloc(64000, sizeof(uint8_t));
-	// load executable into memory
-	memcpy(memory, bytecode, sb.st_size);
-
 	// other
 	struct State8080 cpu_2;
-	cpu_2.memory = calloc(64000, sizeof(uint8_t));
-	memcpy(cpu_2.memory, bytecode, sb.st_size);
+	memset(&cpu_2, 0, sizeof(struct State8080));
+	cpu_2.memory = mem_create();
+	if(cpu_2.memory == NULL) {
+		printf("Out of memory\n");
+		return 1;
+	}
+	mem_load(cpu_2.memory, argv[1], 0, 1);
 
 	char* d8 = malloc(100);
 	char* ot = malloc(100);
 
 	while(1) {
-		execute_instruction(&cpu, memory, out);
+		execute_instruction(&cpu, memory);
 		Emulate8080Op(&cpu_2);
 
 		if(cpu.instr % 1000 == 0) {
@@ -0,0 +1,38 @@
+#include <stdint.h> // uint8_t
+#include <stddef.h> // size_t
+
+struct OP {
+	int size;
+	char *fmt;
+};
+
+// size and printf format of every opcode, the operand bytes go in high byte
+// first. Made from the table in ops.h
+extern const struct OP lookup[256];
+
+// write the instruction at code into buff, returns the instruction size
+int disassemble(char *buff, size_t len, const uint8_t *code);
+
+// The fast way: no printf, the text is put together from tables made by
+// dis_init. Call dis_init before using these from more than one thread,
+// disassemble and dis_lines call it themselves.
+void dis_init(void);
+
+// the two lowercase hex digits of v at out, no NUL
+void dis_hex(char *out, uint8_t v);
+
+#define DIS_LINE 32 // longest line dis_line writes, room for the padding included
+
+// "ADDR: TEXT\n" for the instruction at code, which is at address pc.
+// out needs DIS_LINE bytes. Returns the length, there is no NUL.
+int dis_line(char *out, uint16_t pc, const uint8_t *code);
+
+// as many whole lines as fit into cap bytes, for the instructions from *pc
+// up to end. image holds the bytes from origin on. *pc is moved past the
+// instructions done, returns the number of bytes written.
+size_t dis_lines(char *out, size_t cap, const uint8_t *image, uint16_t origin, uint32_t *pc, uint32_t end);
+
+// disassemble start to end split up between threads, writing the lines to fd
+// in order. Returns 0 or -1 if the write failed. In disasm_mt.c, which
+// needs -lpthread.
+int dis_parallel(int fd, const uint8_t *image, uint16_t origin, uint32_t start, uint32_t end, int threads);
@@ -0,0 +1,108 @@
+// Reference: 4-1 in Intel's 8080 Microprocessor System User's Manual
+
+#include <string.h> // memcpy, strchr
+
+#include "dis.h"
+#include "ops.h"
+
+const struct OP lookup[256] = {
+#define X(op, fmt, len, ...) [op] = {len, fmt},
+	OPCODES(X)
+#undef X
+};
+
+// Everything below avoids printf: the text of each opcode is split once
+// into what comes before the operand and after it, and operand bytes come
+// from a table of hex digit pairs, so a line is a few small memcpys.
+
+static struct {
+	char head[24]; // up to the operand
+	char tail[8]; // after it
+	uint8_t head_len, tail_len;
+} parts[256];
+static char hex_lower[256][2], hex_upper[256][2];
+static int ready;
+
+void dis_init(void) {
+	if(ready) return;
+	const char *digits = "0123456789abcdef", *DIGITS = "0123456789ABCDEF";
+	for(int i = 0;i < 256;i ++) {
+		hex_lower[i][0] = digits[i >> 4]; hex_lower[i][1] = digits[i & 15];
+		hex_upper[i][0] = DIGITS[i >> 4]; hex_upper[i][1] = DIGITS[i & 15];
+
+		const char *fmt = lookup[i].fmt;
+		const char *op = strchr(fmt, '%');
+		const size_t head = op ? (size_t)(op - fmt) : strlen(fmt);
+		// every format ends in its operand ("%02x" or "%02x%02x") if it has one
+		const char *tail = op ? op + 4 * (lookup[i].size - 1) : fmt + head;
+		parts[i].head_len = head;
+		parts[i].tail_len = strlen(tail);
+		memcpy(parts[i].head, fmt, head);
+		memcpy(parts[i].tail, tail, parts[i].tail_len);
+	}
+	ready = 1;
+}
+
+// the text of the instruction, no NUL, returns its length
+static inline int text(char *out, const uint8_t *code) {
+	const uint8_t op = code[0];
+	char *p = out;
+	memcpy(p, parts[op].head, sizeof(parts[op].head));
+	p += parts[op].head_len;
+	switch(lookup[op].size) {
+		case 3:
+			memcpy(p, hex_lower[code[2]], 2);
+			memcpy(p + 2, hex_lower[code[1]], 2);
+			p += 4;
+			break;
+		case 2:
+			memcpy(p, hex_lower[code[1]], 2);
+			p += 2;
+			break;
+	}
+	memcpy(p, parts[op].tail, sizeof(parts[op].tail));
+	return p + parts[op].tail_len - out;
+}
+
+int disassemble(char *buff, size_t len, const uint8_t *code) {
+	dis_init();
+	char line[DIS_LINE];
+	const int n = text(line, code);
+	if(len > 0) {
+		const size_t copy = (size_t)n < len - 1 ? (size_t)n : len - 1;
+		memcpy(buff, line, copy);
+		buff[copy] = '\0';
+	}
+	return lookup[code[0]].size;
+}
+
+void dis_hex(char *out, uint8_t v) {
+	memcpy(out, hex_lower[v], 2);
+}
+
+int dis_line(char *out, uint16_t pc, const uint8_t *code) {
+	memcpy(out, hex_upper[pc >> 8], 2);
+	memcpy(out + 2, hex_upper[pc & 0xFF], 2);
+	out[4] = ':';
+	out[5] = ' ';
+	const int n = 6 + text(out + 6, code);
+	out[n] = '\n';
+	return n + 1;
+}
+
+size_t dis_lines(char *out, size_t cap, const uint8_t *image, uint16_t origin, uint32_t *pc, uint32_t end) {
+	dis_init();
+	size_t len = 0;
+	while(*pc < end && cap - len >= DIS_LINE) {
+		const uint8_t *code = image + (*pc - origin);
+		// the last instruction may be cut off, its missing operand bytes are 0
+		uint8_t last[3] = {0, 0, 0};
+		if(end - *pc < 3) {
+			memcpy(last, code, end - *pc);
+			code = last;
+		}
+		len += dis_line(out + len, *pc, code);
+		*pc += lookup[code[0]].size;
+	}
+	return len;
+}
@@ -0,0 +1,85 @@
+#include <stdlib.h> // malloc
+#include <pthread.h>
+#include <unistd.h> // write
+
+#include "dis.h"
+
+// The image is cut into one piece per thread. The cuts have to fall on
+// instruction boundaries of the sweep, which only takes the sizes from the
+// lookup table to find, so that is done up front on the calling thread.
+
+struct piece {
+	const uint8_t *image;
+	uint16_t origin;
+	uint32_t start, end;
+	char *out;
+	size_t len;
+	pthread_t thread;
+	int started;
+};
+
+static void *format(void *arg) {
+	struct piece *p = arg;
+	uint32_t pc = p->start;
+	// an instruction is at least a byte, so this is always enough room
+	const size_t cap = (size_t)(p->end - p->start) * DIS_LINE;
+	p->len = dis_lines(p->out, cap, p->image, p->origin, &pc, p->end);
+	return NULL;
+}
+
+static int write_all(int fd, const char *buff, size_t len) {
+	while(len > 0) {
+		const ssize_t n = write(fd, buff, len);
+		if(n <= 0) return -1;
+		buff += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int dis_parallel(int fd, const uint8_t *image, uint16_t origin, uint32_t start, uint32_t end, int threads) {
+	if(start >= end) return 0;
+	if(threads < 1) threads = 1;
+	if((uint32_t)threads > end - start) threads = end - start;
+	dis_init();
+
+	struct piece *pieces = calloc(threads, sizeof(struct piece));
+	char *out = malloc((size_t)(end - start) * DIS_LINE);
+	if(pieces == NULL || out == NULL) {
+		free(pieces);
+		free(out);
+		return -1;
+	}
+
+	// cut at the first instruction at or after every 1/threads of the range
+	uint32_t pc = start;
+	for(int i = 0;i < threads;i ++) {
+		const uint32_t want = start + (uint64_t)(end - start) * i / threads;
+		while(pc < want) pc += lookup[image[pc - origin]].size;
+		pieces[i].start = pc < end ? pc : end;
+	}
+
+	int err = 0;
+	for(int i = 0;i < threads;i ++) {
+		struct piece *p = &pieces[i];
+		p->image = image;
+		p->origin = origin;
+		p->end = i + 1 < threads ? pieces[i + 1].start : end;
+		p->out = out + (size_t)(p->start - start) * DIS_LINE;
+		// the calling thread does the last piece itself
+		if(i + 1 == threads) break;
+		p->started = pthread_create(&p->thread, NULL, format, p) == 0;
+		if(!p->started) format(p);
+	}
+	format(&pieces[threads - 1]);
+
+	for(int i = 0;i < threads;i ++) {
+		// written as soon as it is done, while the later pieces are still going
+		if(pieces[i].started) pthread_join(pieces[i].thread, NULL);
+		if(!err && write_all(fd, pieces[i].out, pieces[i].len) != 0) err = -1;
+	}
+
+	free(pieces);
+	free(out);
+	return err;
+}
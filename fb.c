@@ -0,0 +1,271 @@
+#include <string.h> // memcpy
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FB_X86
+#endif
+
+#include "fb.h"
+
+#define PIXEL_ON  0xFFFFFFFF
+#define PIXEL_OFF 0xFF000000
+
+// Every converter works on a tile of columns at a time. For each byte row j
+// of the tile the bytes of all the columns are transposed as a bit matrix, so
+// that bit k of byte j of every column ends up in one word - the 8 or 16
+// horizontally adjacent pixels of screen row 255 - (8j + k). That word is then
+// expanded to ARGB and written out with a single run of stores.
+
+static inline uint8_t *row(uint8_t *out, int pitch, int j, int k, int x) {
+	return out + (FB_HEIGHT - 1 - (j * 8 + k)) * pitch + x * 4;
+}
+
+// plain C: 8x8 bit transpose in a 64 bit word and a lookup table
+static uint32_t expand[256][8];
+
+// bit 8r+c goes to bit 8c+r (Hacker's Delight, transpose8)
+static inline uint64_t transpose8(uint64_t x) {
+	uint64_t t;
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x = x ^ t ^ (t << 28);
+	return x;
+}
+
+static void convert_c(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1) {
+	if(expand[1][0] == 0) {
+		for(int m = 0;m < 256;m ++) {
+			for(int c = 0;c < 8;c ++) expand[m][c] = (m >> c) & 1 ? PIXEL_ON : PIXEL_OFF;
+		}
+	}
+
+	for(int x = x0 & ~7;x < x1;x += 8) {
+		const uint8_t *col = vram + x * 32;
+		for(int j = 0;j < 32;j ++) {
+			uint64_t v = 0;
+			for(int c = 0;c < 8;c ++) v |= (uint64_t)col[c * 32 + j] << (8 * c);
+			v = transpose8(v);
+
+			for(int k = 0;k < 8;k ++) {
+				memcpy(row(out, pitch, j, k, x), expand[(v >> (8 * k)) & 0xFF], 32);
+			}
+		}
+	}
+}
+
+// The scaled converters do the same thing, except that the pixels of a row
+// are widened and stored scale times over, and lit pixels take the row's
+// color instead of white.
+
+static inline uint8_t *scaled(uint8_t *out, int pitch, int y, int r, int x, int scale) {
+	return out + (size_t)(y * scale + r) * pitch + (size_t)x * scale * 4;
+}
+
+#define PIXEL_RED   0xFFFF2020
+#define PIXEL_GREEN 0xFF20FF20
+#define PIXEL_WHITE PIXEL_ON
+
+#ifdef FB_X86
+
+// 16x16 byte transpose, four rounds of interleaving row i with row i+8
+static inline void transpose16(__m128i r[16]) {
+	__m128i t[16];
+	for(int round = 0;round < 4;round ++) {
+		for(int i = 0;i < 8;i ++) {
+			t[2 * i]     = _mm_unpacklo_epi8(r[i], r[i + 8]);
+			t[2 * i + 1] = _mm_unpackhi_epi8(r[i], r[i + 8]);
+		}
+		memcpy(r, t, sizeof(t));
+	}
+}
+
+// SSE2: 16 columns at a time, the bytes are transposed with unpacks and
+// movemask pulls out one screen row of 16 pixels per shift. Each nibble of
+// that is 4 pixels, which come from a 16 entry table of compare masks.
+static void convert_sse2(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1) {
+	const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+	const __m128i off = _mm_set1_epi32(PIXEL_OFF);
+	__m128i nibble[16];
+	for(int m = 0;m < 16;m ++) {
+		const __m128i g = _mm_and_si128(_mm_set1_epi32(m), bits);
+		nibble[m] = _mm_or_si128(_mm_cmpeq_epi32(g, bits), off);
+	}
+
+	for(int x = x0 & ~15;x < x1;x += 16) {
+		const uint8_t *col = vram + x * 32;
+		for(int half = 0;half < 32;half += 16) {
+			__m128i r[16];
+			for(int c = 0;c < 16;c ++) r[c] = _mm_loadu_si128((const __m128i *)(col + c * 32 + half));
+			transpose16(r);
+
+			for(int j = 0;j < 16;j ++) {
+				__m128i v = r[j];
+				for(int k = 7;k >= 0;k --) {
+					const int m = _mm_movemask_epi8(v);
+					v = _mm_add_epi8(v, v);
+
+					__m128i *dst = (__m128i *)row(out, pitch, half + j, k, x);
+					_mm_storeu_si128(dst + 0, nibble[(m >> 0) & 0xF]);
+					_mm_storeu_si128(dst + 1, nibble[(m >> 4) & 0xF]);
+					_mm_storeu_si128(dst + 2, nibble[(m >> 8) & 0xF]);
+					_mm_storeu_si128(dst + 3, nibble[(m >> 12) & 0xF]);
+				}
+			}
+		}
+	}
+}
+
+// AVX2: same transpose, but 8 pixels per store
+__attribute__((target("avx2")))
+static void convert_avx2(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1) {
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m256i off = _mm256_set1_epi32(PIXEL_OFF);
+
+	for(int x = x0 & ~15;x < x1;x += 16) {
+		const uint8_t *col = vram + x * 32;
+		for(int half = 0;half < 32;half += 16) {
+			__m128i r[16];
+			for(int c = 0;c < 16;c ++) r[c] = _mm_loadu_si128((const __m128i *)(col + c * 32 + half));
+			transpose16(r);
+
+			for(int j = 0;j < 16;j ++) {
+				__m128i v = r[j];
+				for(int k = 7;k >= 0;k --) {
+					const int m = _mm_movemask_epi8(v);
+					v = _mm_add_epi8(v, v);
+
+					__m256i *dst = (__m256i *)row(out, pitch, half + j, k, x);
+					const __m256i lo = _mm256_and_si256(_mm256_set1_epi32(m), bits);
+					const __m256i hi = _mm256_and_si256(_mm256_set1_epi32(m >> 8), bits);
+					_mm256_storeu_si256(dst, _mm256_or_si256(_mm256_cmpeq_epi32(lo, bits), off));
+					_mm256_storeu_si256(dst + 1, _mm256_or_si256(_mm256_cmpeq_epi32(hi, bits), off));
+				}
+			}
+		}
+	}
+}
+
+// SSE2, scaled: the nibble table is widened into scale vectors per nibble
+static void scale_sse2(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1, int scale, const uint32_t *colors) {
+	// masks for 4 * scale output pixels made out of a nibble of input ones
+	__m128i widen[16][FB_MAX_SCALE];
+	for(int m = 0;m < 16;m ++) {
+		for(int q = 0;q < scale;q ++) {
+			uint32_t lanes[4];
+			for(int l = 0;l < 4;l ++) lanes[l] = (m >> ((q * 4 + l) / scale)) & 1 ? 0xFFFFFFFF : 0;
+			widen[m][q] = _mm_loadu_si128((const __m128i *)lanes);
+		}
+	}
+	const __m128i off = _mm_set1_epi32(PIXEL_OFF);
+
+	for(int x = x0 & ~15;x < x1;x += 16) {
+		const uint8_t *col = vram + x * 32;
+		for(int half = 0;half < 32;half += 16) {
+			__m128i r[16];
+			for(int c = 0;c < 16;c ++) r[c] = _mm_loadu_si128((const __m128i *)(col + c * 32 + half));
+			transpose16(r);
+
+			for(int j = 0;j < 16;j ++) {
+				__m128i v = r[j];
+				for(int k = 7;k >= 0;k --) {
+					const int m = _mm_movemask_epi8(v);
+					v = _mm_add_epi8(v, v);
+
+					// off ^ (mask & (on ^ off)) picks on or off per pixel
+					const int y = FB_HEIGHT - 1 - ((half + j) * 8 + k);
+					const __m128i flip = _mm_set1_epi32(colors[y] ^ PIXEL_OFF);
+					__m128i px[4 * FB_MAX_SCALE];
+					for(int nib = 0;nib < 4;nib ++) {
+						const int mm = (m >> (nib * 4)) & 0xF;
+						for(int q = 0;q < scale;q ++) {
+							px[nib * scale + q] = _mm_xor_si128(off, _mm_and_si128(widen[mm][q], flip));
+						}
+					}
+					for(int rr = 0;rr < scale;rr ++) {
+						__m128i *dst = (__m128i *)scaled(out, pitch, y, rr, x, scale);
+						for(int i = 0;i < 4 * scale;i ++) _mm_storeu_si128(dst + i, px[i]);
+					}
+				}
+			}
+		}
+	}
+}
+
+#endif
+
+// plain C, scaled: one output line is built and copied scale times
+static void scale_c(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1, int scale, const uint32_t *colors) {
+	for(int x = x0 & ~7;x < x1;x += 8) {
+		const uint8_t *col = vram + x * 32;
+		for(int j = 0;j < 32;j ++) {
+			uint64_t v = 0;
+			for(int c = 0;c < 8;c ++) v |= (uint64_t)col[c * 32 + j] << (8 * c);
+			v = transpose8(v);
+
+			for(int k = 0;k < 8;k ++) {
+				const int y = FB_HEIGHT - 1 - (j * 8 + k);
+				const uint8_t bits = v >> (8 * k);
+
+				uint32_t line[8 * FB_MAX_SCALE];
+				for(int c = 0;c < 8;c ++) {
+					const uint32_t px = (bits >> c) & 1 ? colors[y] : PIXEL_OFF;
+					for(int i = 0;i < scale;i ++) line[c * scale + i] = px;
+				}
+				for(int rr = 0;rr < scale;rr ++) memcpy(scaled(out, pitch, y, rr, x, scale), line, 8 * scale * 4);
+			}
+		}
+	}
+}
+
+static void (*convert)(const uint8_t *, uint8_t *, int, int, int);
+static void (*convert_scaled)(const uint8_t *, uint8_t *, int, int, int, int, const uint32_t *);
+static const char *convert_name;
+
+static void pick(void) {
+	convert = convert_c;
+	convert_scaled = scale_c;
+	convert_name = "c";
+#ifdef FB_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2")) { convert = convert_sse2; convert_scaled = scale_sse2; convert_name = "sse2"; }
+	if(__builtin_cpu_supports("avx2")) { convert = convert_avx2; convert_name = "avx2"; }
+#endif
+}
+
+void fb_convert(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1) {
+	if(convert == NULL) pick();
+	convert(vram, out, pitch, x0, x1);
+}
+
+const char *fb_impl(void) {
+	if(convert == NULL) pick();
+	return convert_name;
+}
+
+void fb_scale(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1, int scale, const uint32_t *colors) {
+	if(convert == NULL) pick();
+	if(colors == NULL) {
+		if(scale == 1) {
+			convert(vram, out, pitch, x0, x1);
+			return;
+		}
+
+		static uint32_t white[FB_HEIGHT];
+		if(white[0] == 0) {
+			for(int y = 0;y < FB_HEIGHT;y ++) white[y] = PIXEL_WHITE;
+		}
+		colors = white;
+	}
+	convert_scaled(vram, out, pitch, x0, x1, scale, colors);
+}
+
+void fb_overlay(uint32_t colors[FB_HEIGHT]) {
+	for(int y = 0;y < FB_HEIGHT;y ++) {
+		colors[y] = PIXEL_WHITE;
+		if(y >= 32 && y < 64) colors[y] = PIXEL_RED;
+		if(y >= 184) colors[y] = PIXEL_GREEN;
+	}
+}
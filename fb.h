@@ -0,0 +1,29 @@
+#include <stdint.h> // uint8_t, uint32_t
+
+// Space Invaders video RAM: 224 columns of 32 bytes each, 1 bit per pixel.
+// The monitor is rotated, so column x is screen column x, read bottom to top,
+// lowest bit first.
+
+#define FB_WIDTH  224
+#define FB_HEIGHT 256
+#define FB_VRAM   0x2400
+#define FB_COLUMN (FB_HEIGHT / 8) // bytes
+#define FB_BYTES  (FB_WIDTH * FB_COLUMN)
+
+// expand columns x0 to x1 (exclusive) of vram into an upright ARGB8888 image,
+// pitch is the length of an output row in bytes. Works in tiles of 16
+// columns, so a few columns around the range may be redone too.
+void fb_convert(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1);
+
+// Same, but every pixel becomes a scale x scale block (scale is at most
+// FB_MAX_SCALE) and lit pixels of screen row y get colors[y]. The output is
+// FB_WIDTH * scale by FB_HEIGHT * scale. colors can be NULL for white.
+#define FB_MAX_SCALE 8
+void fb_scale(const uint8_t *vram, uint8_t *out, int pitch, int x0, int x1, int scale, const uint32_t *colors);
+
+// the colored strips of the cabinet's overlay: red at the top where the UFO
+// flies, green at the bottom over the player and the shields
+void fb_overlay(uint32_t colors[FB_HEIGHT]);
+
+// which implementation fb_convert picked for this CPU
+const char *fb_impl(void);
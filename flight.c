@@ -0,0 +1,127 @@
+#include <string.h> // strlen, memcpy
+#include <signal.h> // sigaction
+#include <fcntl.h> // open
+#include <unistd.h> // write
+
+#include "flight.h"
+#include "dis.h"
+
+static struct flight_recorder *installed;
+static const char *installed_path;
+
+static void write_all(int fd, const char *buff, size_t len) {
+	while(len > 0) {
+		const ssize_t n = write(fd, buff, len);
+		if(n <= 0) return;
+		buff += n;
+		len -= n;
+	}
+}
+
+// Only uses the tables from dis_init and write, no printf, so that it can be
+// called from a signal handler. flight_install sets the tables up beforehand.
+void flight_dump(const struct flight_recorder *rec, int fd, uint32_t count) {
+	dis_init();
+	if(count > FLIGHT_RECORDS) count = FLIGHT_RECORDS;
+	if(count > rec->pos) count = rec->pos;
+
+	char buff[1 << 14];
+	size_t len = 0;
+	for(uint32_t i = rec->pos - count;i != rec->pos;i ++) {
+		const struct flight_record *r = &rec->ring[i & (FLIGHT_RECORDS - 1)];
+
+		if(sizeof(buff) - len < 128) {
+			write_all(fd, buff, len);
+			len = 0;
+		}
+
+		// "PC: INSTRUCTION" padded out to 16 characters of instruction
+		char *p = buff + len;
+		p += dis_line(p, r->pc, r->op) - 1;
+		while(p < buff + len + 6 + 16) *p ++ = ' ';
+
+		const struct { char name[6]; uint8_t hi, lo; int pair; } regs[] = {
+			{" A=", r->A, 0, 0},
+			{", BC=", r->B, r->C, 1},
+			{", DE=", r->D, r->E, 1},
+			{", HL=", r->H, r->L, 1},
+			{", sp=", r->sp >> 8, r->sp & 0xFF, 1},
+		};
+		for(size_t j = 0;j < sizeof(regs) / sizeof(regs[0]);j ++) {
+			const size_t n = strlen(regs[j].name);
+			memcpy(p, regs[j].name, n);
+			p += n;
+			dis_hex(p, regs[j].hi);
+			p += 2;
+			if(regs[j].pair) {
+				dis_hex(p, regs[j].lo);
+				p += 2;
+			}
+		}
+
+		memcpy(p, ", flags=.....\n", 14);
+		if(r->flags & (1 << 0)) p[8] = 'Z';
+		if(r->flags & (1 << 1)) p[9] = 'S';
+		if(r->flags & (1 << 2)) p[10] = 'P';
+		if(r->flags & (1 << 3)) p[11] = 'C';
+		if(r->flags & (1 << 4)) p[12] = 'A';
+		p += 14;
+		len = p - buff;
+	}
+	write_all(fd, buff, len);
+}
+
+void flight_crash(const struct flight_recorder *rec) {
+	const char msg[] = "Last instructions:\n";
+	write_all(STDERR_FILENO, msg, strlen(msg));
+	flight_dump(rec, STDERR_FILENO, 32);
+
+	if(rec != installed || installed_path == NULL) return;
+
+	const int fd = open(installed_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) return;
+	flight_dump(rec, fd, FLIGHT_RECORDS);
+	close(fd);
+
+	const char note[] = "Flight recorder written to ";
+	write_all(STDERR_FILENO, note, strlen(note));
+	write_all(STDERR_FILENO, installed_path, strlen(installed_path));
+	write_all(STDERR_FILENO, "\n", 1);
+}
+
+static void on_fatal(int sig) {
+	flight_crash(installed);
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void on_demand(int sig) {
+	if(installed_path == NULL) {
+		flight_dump(installed, STDERR_FILENO, FLIGHT_RECORDS);
+		return;
+	}
+
+	const int fd = open(installed_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) return;
+	flight_dump(installed, fd, FLIGHT_RECORDS);
+	close(fd);
+}
+
+void flight_install(struct flight_recorder *rec, const char *path) {
+	installed = rec;
+	installed_path = path;
+	dis_init(); // so that the handler doesn't have to build the tables
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+
+	sa.sa_handler = on_fatal;
+	sa.sa_flags = SA_RESETHAND;
+	const int fatal[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+	for(size_t i = 0;i < sizeof(fatal) / sizeof(fatal[0]);i ++) sigaction(fatal[i], &sa, NULL);
+
+	sa.sa_handler = on_demand;
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, NULL);
+}
@@ -0,0 +1,33 @@
+#include <stdint.h> // uint8_t, uint16_t, uint32_t
+
+// Flight recorder - remembers the last FLIGHT_RECORDS executed instructions
+// so that we have something to look at when the emulator dies.
+// Recording is a single 16 byte store per instruction, cheap enough to
+// leave on all the time.
+
+#define FLIGHT_RECORDS (1 << 16) // must be a power of two
+
+struct flight_record {
+	uint8_t A, B, C, D, E, H, L, flags; // state before the instruction ran
+	uint16_t sp, pc;
+	uint8_t op[3]; // instruction bytes, in case the code changes later
+	uint8_t pad;
+};
+
+struct flight_recorder {
+	struct flight_record ring[FLIGHT_RECORDS];
+	uint32_t pos; // total number of records written, wraps around the ring
+};
+
+// write the last count records (oldest first) to fd, disassembled. Safe to
+// call from a signal handler.
+void flight_dump(const struct flight_recorder *rec, int fd, uint32_t count);
+
+// dump the recorder to path when the process crashes (SIGSEGV, SIGBUS,
+// SIGILL, SIGFPE, SIGABRT), or on SIGUSR1 without stopping. With path NULL
+// a crash only shows the last few instructions and SIGUSR1 dumps to stderr.
+// Only one recorder can be installed at a time.
+void flight_install(struct flight_recorder *rec, const char *path);
+
+// called from the core when it can't go on
+void flight_crash(const struct flight_recorder *rec);
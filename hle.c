@@ -0,0 +1,109 @@
+#include <stddef.h> // offsetof
+#include <stdio.h> // fprintf
+#include <string.h> // memcmp, memcpy
+
+#include "8080.h"
+#include "hle.h"
+#include "mem.h"
+
+int hle_init(struct hle *hle, int check) {
+	memset(hle, 0, sizeof(struct hle));
+	hle->check = check;
+	if(check) {
+		hle->scratch = mem_create();
+		if(hle->scratch == NULL) return -1;
+	}
+	return 0;
+}
+
+void hle_free(struct hle *hle) {
+	if(hle->scratch) mem_destroy(hle->scratch);
+	hle->scratch = NULL;
+}
+
+int hle_add(struct hle *hle, const struct hle_hook *hook, const uint8_t *memory) {
+	if(hle->nhooks == HLE_MAX) return -1;
+	if(memcmp(memory + hook->addr, hook->code, hook->len) != 0) return -1;
+
+	hle->hooks[hle->nhooks ++] = hook;
+	hle->at[hook->addr >> 3] |= 1 << (hook->addr & 7);
+	return 0;
+}
+
+// run the hook and the interpreter side by side, keep the interpreter's
+// result if they don't agree
+static int checked(struct hle *hle, const struct hle_hook *hook, struct i8080 *cpu, uint8_t *memory, uint64_t until) {
+	static uint8_t dirty_ref[DIRTY_SIZE], dirty_hook[DIRTY_SIZE];
+	uint8_t *dirty = cpu->dirty;
+
+	struct i8080 ref = *cpu;
+	ref.ports = NULL;
+	ref.recorder = NULL;
+	ref.watch = NULL;
+	ref.dirty = dirty ? dirty_ref : NULL;
+	memset(dirty_ref, 0, DIRTY_SIZE);
+	memcpy(hle->scratch, memory, MEM_SIZE);
+
+	cpu->dirty = dirty ? dirty_hook : NULL;
+	memset(dirty_hook, 0, DIRTY_SIZE);
+	const int ran = hook->run(cpu, memory, until);
+	cpu->dirty = dirty;
+	if(!ran) return 0;
+
+	// the interpreter goes as far as the hook did: to the routine's RET,
+	// which takes the stack back to the caller's (where it returns to is up
+	// to the routine, it may have written over it), or partway if the hook
+	// stopped there
+	const uint16_t sp = ref.sp;
+	while(ref.sp != (uint16_t)(sp + 2) && !getFlag(&ref, HLT) && ref.clock_cnt < cpu->clock_cnt) {
+		execute_instruction(&ref, hle->scratch);
+	}
+
+	const int same = memcmp(cpu, &ref, offsetof(struct i8080, pc) + sizeof(cpu->pc)) == 0
+		&& cpu->clock_cnt == ref.clock_cnt
+		&& memcmp(memory, hle->scratch, MEM_SIZE) == 0
+		&& memcmp(dirty_hook, dirty_ref, DIRTY_SIZE) == 0;
+	if(!same) {
+		hle->mismatches ++;
+		fprintf(stderr, "HLE %s differs from the interpreter: pc %04x/%04x sp %04x/%04x A %02x/%02x flags %02x/%02x cycles %llu/%llu\n",
+				hook->name, cpu->pc, ref.pc, cpu->sp, ref.sp, cpu->A, ref.A, cpu->flags, ref.flags,
+				(unsigned long long)cpu->clock_cnt, (unsigned long long)ref.clock_cnt);
+
+		// only what differs is written back, the ROM may be read only
+		for(uint32_t i = 0;i < MEM_SIZE;i ++) {
+			if(memory[i] == hle->scratch[i]) continue;
+			memory[i] = hle->scratch[i];
+			memory_written(cpu, i, 1);
+		}
+		ref.ports = cpu->ports;
+		ref.recorder = cpu->recorder;
+		ref.dirty = dirty;
+		ref.watch = cpu->watch;
+		*cpu = ref;
+	}
+
+	if(dirty) {
+		const uint8_t *wrote = same ? dirty_hook : dirty_ref;
+		for(int i = 0;i < DIRTY_SIZE;i ++) dirty[i] |= wrote[i];
+	}
+	return 1;
+}
+
+int hle_call(struct hle *hle, struct i8080 *cpu, uint8_t *memory, uint64_t until) {
+	const uint16_t pc = cpu->pc;
+	if(!(hle->at[pc >> 3] >> (pc & 7) & 1) || getFlag(cpu, HLT)) return 0;
+
+	for(uint32_t i = 0;i < hle->nhooks;i ++) {
+		const struct hle_hook *hook = hle->hooks[i];
+		if(hook->addr != pc) continue;
+
+		// the ROM is read only, but the code could still be RAM
+		if(memcmp(memory + pc, hook->code, hook->len) != 0) return 0;
+
+		flags_flush(cpu);
+		const int ran = hle->check ? checked(hle, hook, cpu, memory, until) : hook->run(cpu, memory, until);
+		hle->calls += ran;
+		return ran;
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <stdint.h> // uint8_t, uint16_t, uint64_t
+
+struct i8080;
+
+// High level emulation: native C versions of hot guest routines. A hook is
+// registered at the address a routine starts at, along with the bytes the
+// routine is made of. If the memory there doesn't hold exactly those, the
+// hook is left out, so it never runs in place of code it wasn't written for.
+//
+// When pc reaches a hooked address (a CALL just went there, or it is the
+// head of a loop the routine can be resumed at) the hook does everything
+// the routine would: the same memory writes, registers, flags and cycles,
+// and the RET at the end. Hooks are for routines without I/O.
+//
+// With check set every call is also run by the interpreter on a copy of
+// memory and the two are compared. A difference is reported on stderr and
+// the interpreter's result is kept.
+
+#define HLE_MAX 32
+
+struct hle_hook {
+	const char *name;
+	uint16_t addr;
+	const uint8_t *code; // the routine, up to and including its RET
+	uint8_t len;
+	// run the routine and return from it. It must not take the clock past
+	// until: it either stops partway, with pc inside the routine where the
+	// interpreter carries on, or returns 0 without changing anything.
+	int (*run)(struct i8080 *cpu, uint8_t *memory, uint64_t until);
+};
+
+struct hle {
+	const struct hle_hook *hooks[HLE_MAX];
+	uint32_t nhooks;
+	uint8_t at[0x10000 / 8]; // a bit for every address with a hook
+
+	int check;
+	uint8_t *scratch; // the interpreter's memory when checking
+	uint64_t calls, mismatches;
+};
+
+// 0 or -1 if out of memory
+int hle_init(struct hle *hle, int check);
+void hle_free(struct hle *hle);
+
+// 0, or -1 if the code at hook->addr isn't the hook's or there is no room
+int hle_add(struct hle *hle, const struct hle_hook *hook, const uint8_t *memory);
+
+// if there is a hook at cpu->pc, run it. Returns 1 when it ran, 0 when the
+// instruction at pc is still to be executed.
+int hle_call(struct hle *hle, struct i8080 *cpu, uint8_t *memory, uint64_t until);
@@ -0,0 +1,145 @@
+#include <string.h> // memmove, memset
+
+#include "8080.h"
+#include "idiom.h"
+#include "ops.h"
+
+static int match(struct idiom *idiom, const uint8_t *memory, uint16_t start) {
+	// the mirror after 0xFFFF makes reading on past the end safe
+	const uint8_t *p = memory + start;
+	int at;
+	memset(idiom, 0, sizeof(struct idiom));
+
+	if(p[0] == 0x1a && p[1] == 0x77 && p[2] == 0x23 && p[3] == 0x13) {
+		idiom->kind = IDIOM_COPY_DE;
+		at = 4;
+	} else if(p[0] == 0x7e && p[1] == 0x12 && p[2] == 0x23 && p[3] == 0x13) {
+		idiom->kind = IDIOM_COPY_HL;
+		at = 4;
+	} else if(p[0] == 0x36 && p[2] == 0x23) {
+		idiom->kind = IDIOM_FILL;
+		idiom->value = p[1];
+		at = 3;
+	} else if(p[0] == 0x77 && p[1] == 0x23) {
+		idiom->kind = IDIOM_FILL;
+		idiom->from_a = 1;
+		at = 2;
+	} else {
+		return 0;
+	}
+
+	const uint8_t op = p[at];
+	if(op == 0x05 || op == 0x0d || op == 0x15 || op == 0x1d) {
+		// a copy can't count with D or E, those are its pointer
+		if(idiom->kind != IDIOM_FILL && (op == 0x15 || op == 0x1d)) return 0;
+		idiom->count = IDIOM_DCR;
+		idiom->reg = op;
+		at += 1;
+	} else if(op == 0x0b && p[at + 1] == 0x78 && p[at + 2] == 0xb1) {
+		idiom->count = IDIOM_BC;
+		at += 3;
+	} else if(op == 0x7c && p[at + 1] == 0xfe) {
+		idiom->count = IDIOM_H;
+		idiom->reg = p[at + 2];
+		at += 3;
+	} else {
+		return 0;
+	}
+	// those two change A, which MOV M,A stores
+	if(idiom->from_a && idiom->count != IDIOM_DCR) return 0;
+
+	if(p[at] != 0xc2 || (p[at + 1] | p[at + 2] << 8) != start) return 0;
+	idiom->len = at + 3;
+
+	for(int i = 0;i < idiom->len;i += ops[p[i]].len) {
+		idiom->n ++;
+		idiom->cycles += ops[p[i]].cycles;
+	}
+	return 1;
+}
+
+int idiom_match(struct idiom *idiom, const uint8_t *memory, uint16_t start) {
+	if(match(idiom, memory, start)) return 1;
+	idiom->kind = IDIOM_NONE;
+	return 0;
+}
+
+static uint8_t *counter(struct i8080 *cpu, uint8_t op) {
+	switch(op) {
+		case 0x05: return &cpu->B;
+		case 0x0d: return &cpu->C;
+		case 0x15: return &cpu->D;
+		default: return &cpu->E;
+	}
+}
+
+// memmove within the 64K, in pieces that don't run past the end, so that
+// the mirror can't hide an overlap from it
+static void move(uint8_t *memory, uint16_t dst, uint16_t src, uint32_t len) {
+	while(len > 0) {
+		uint32_t piece = len;
+		if(piece > 0x10000 - dst) piece = 0x10000 - dst;
+		if(piece > 0x10000 - src) piece = 0x10000 - src;
+		memmove(memory + dst, memory + src, piece);
+		dst += piece;
+		src += piece;
+		len -= piece;
+	}
+}
+
+int idiom_run(const struct idiom *idiom, struct i8080 *cpu, uint8_t *memory, uint64_t until) {
+	const uint16_t hl = rpHL(cpu), de = rpDE(cpu), bc = rpBC(cpu);
+
+	// times around until it falls through
+	uint32_t n;
+	switch(idiom->count) {
+		case IDIOM_DCR: {
+			const uint8_t r = *counter(cpu, idiom->reg);
+			n = r ? r : 0x100;
+			break;
+		}
+		case IDIOM_BC:
+			n = bc ? bc : 0x10000;
+			break;
+		default: {
+			const uint16_t left = (idiom->reg << 8) - hl;
+			n = ((uint16_t)(hl + 1) >> 8) == idiom->reg || left == 0 ? 1 : left;
+			break;
+		}
+	}
+	if(cpu->clock_cnt + idiom->cycles > until) return 0;
+	const uint64_t fit = (until - cpu->clock_cnt) / idiom->cycles;
+	if(n > fit) n = fit;
+	if(n < 2) return 0;
+
+	// all but the last time around
+	const uint32_t k = n - 1;
+	const uint16_t src = idiom->kind == IDIOM_COPY_HL ? hl : de;
+	const uint16_t dst = idiom->kind == IDIOM_COPY_HL ? de : hl;
+
+	if((uint16_t)(cpu->pc - dst) < k || (uint16_t)(dst - cpu->pc) < idiom->len) return 0;
+
+	if(idiom->kind == IDIOM_FILL) {
+		// one memset, the part past 0xFFFF lands in the mirror
+		memset(memory + dst, idiom->from_a ? cpu->A : idiom->value, k);
+	} else if((uint16_t)(dst - src) != 0 && (uint16_t)(dst - src) < k) {
+		// the destination runs into the source ahead of it, what was
+		// copied gets copied again
+		for(uint32_t i = 0;i < k;i ++) memory[(uint16_t)(dst + i)] = memory[(uint16_t)(src + i)];
+	} else {
+		move(memory, dst, src, k);
+	}
+	memory_written(cpu, dst, k);
+
+	srpHL(cpu, hl + k);
+	if(idiom->kind != IDIOM_FILL) srpDE(cpu, de + k);
+	if(idiom->count == IDIOM_DCR) *counter(cpu, idiom->reg) -= k;
+	if(idiom->count == IDIOM_BC) srpBC(cpu, bc - k);
+	cpu->clock_cnt += (uint64_t)k * idiom->cycles;
+	cpu->instr += k * idiom->n;
+
+	// A and the flags are set again every time around, so running the last
+	// one is enough to get them right
+	for(int i = 0;i < idiom->n;i ++) execute_instruction(cpu, memory);
+	return 1;
+}
@@ -0,0 +1,53 @@
+#include <stdint.h> // uint8_t, uint64_t
+
+struct i8080;
+
+// Copy and fill loops, recognised by their code and run as one memmove or
+// memset. The shapes known are
+//
+//   LDAX D; MOV M,A    or  MOV A,M; STAX D    copy, then INX H; INX D
+//   MVI M,n            or  MOV M,A            fill, then INX H
+//
+// followed by how they count,
+//
+//   DCR r                       r times (B, C, D or E, not a pointer)
+//   DCX B; MOV A,B; ORA C       BC times
+//   MOV A,H; CPI n              until H reaches n
+//
+// and a JNZ back to the first instruction. A forward copy whose destination
+// runs into its source repeats the bytes in between just like the loop
+// does, and a loop that would write over its own code is left alone.
+
+enum idiom_kind {
+	IDIOM_NONE,
+	IDIOM_COPY_DE, // from DE to HL
+	IDIOM_COPY_HL, // from HL to DE
+	IDIOM_FILL,    // at HL
+};
+
+enum idiom_count {
+	IDIOM_DCR, // reg is the opcode of the DCR
+	IDIOM_BC,
+	IDIOM_H,   // reg is what H is compared with
+};
+
+struct idiom {
+	uint8_t kind; // enum idiom_kind
+	uint8_t count; // enum idiom_count
+	uint8_t reg;
+	uint8_t value; // what a fill with MVI M stores
+	uint8_t from_a; // a fill with MOV M,A
+	uint8_t len; // bytes of the loop
+	uint8_t n; // instructions
+	uint8_t cycles; // of one time around
+};
+
+// whether the code at start is one of the loops, fills in idiom if it is
+int idiom_match(struct idiom *idiom, const uint8_t *memory, uint16_t start);
+
+// run the loop at cpu->pc as far as it goes or as many times around as fit
+// before the clock reaches until. All but the last time around are done
+// natively, the last one is interpreted, so that A, the flags and pc end up
+// exactly as the real loop leaves them. The flags must not be deferred
+// (block.h). Returns 0 when it wasn't worth it and nothing was run.
+int idiom_run(const struct idiom *idiom, struct i8080 *cpu, uint8_t *memory, uint64_t until);
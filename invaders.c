@@ -0,0 +1,62 @@
+#include <string.h> // memset
+
+#include "8080.h"
+#include "invaders.h"
+#include "audio.h"
+
+static void shift_amount(void *ctx, uint8_t port, uint8_t data) {
+	struct invaders_io *io = ctx;
+	io->amount = data & 7;
+}
+
+static void shift_data(void *ctx, uint8_t port, uint8_t data) {
+	struct invaders_io *io = ctx;
+	io->shift = data << 8 | io->shift >> 8;
+}
+
+static uint8_t shift_result(void *ctx, uint8_t port) {
+	const struct invaders_io *io = ctx;
+	return io->shift >> (8 - io->amount);
+}
+
+static void sound(void *ctx, uint8_t port, uint8_t data) {
+	struct invaders_io *io = ctx;
+	if(io->audio) audio_out(io->audio, port, data, *io->clock);
+}
+
+void invaders_io_init(struct invaders_io *io, struct ports *ports) {
+	io->shift = 0;
+	io->amount = 0;
+	io->audio = NULL;
+	io->clock = NULL;
+
+	memset(ports, 0, sizeof(struct ports));
+	ports->ctx = io;
+	ports->value[0] = 0b00001110; // bits 1-3 should be always set
+	ports->value[1] = 0b00001000; // bit 3 should be always set
+	ports->value[2] = 0b00000000; // 3 ships, bonus at 1500, coin info shown
+	ports->in[3] = shift_result;
+	ports->out[2] = shift_amount;
+	ports->out[4] = shift_data;
+	ports->out[3] = sound;
+	ports->out[5] = sound;
+	// 6 is the watchdog, nothing to do for it
+}
+
+#define HELD(b) ((buttons >> (b)) & 1)
+
+void invaders_buttons(struct ports *ports, uint32_t buttons) {
+	ports->value[1] = (ports->value[1] & 0b10001000)
+		| HELD(INVADERS_COIN) << 0
+		| HELD(INVADERS_P2_START) << 1
+		| HELD(INVADERS_P1_START) << 2
+		| HELD(INVADERS_P1_FIRE) << 4
+		| HELD(INVADERS_P1_LEFT) << 5
+		| HELD(INVADERS_P1_RIGHT) << 6;
+
+	// the rest of port 2 are DIP switches
+	ports->value[2] = (ports->value[2] & 0b10001111)
+		| HELD(INVADERS_P2_FIRE) << 4
+		| HELD(INVADERS_P2_LEFT) << 5
+		| HELD(INVADERS_P2_RIGHT) << 6;
+}
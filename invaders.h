@@ -0,0 +1,47 @@
+#include <stdint.h> // uint8_t, uint16_t
+
+struct ports;
+struct audio;
+struct hle;
+
+// The I/O ports of the Space Invaders board.
+//
+// IN:  0, 1, 2 - switches and buttons, 3 - shift register result
+// OUT: 2 - shift amount, 3 and 5 - sounds, 4 - shift data, 6 - watchdog
+//
+// The MB14241 shifts a 16 bit value, which the game uses to move sprites
+// around by single pixels. Writing port 4 pushes a byte in from the top,
+// port 3 reads the 8 bits starting at 8 - amount from the top.
+
+struct invaders_io {
+	uint16_t shift;
+	uint8_t amount;
+
+	// optional, sound port writes go to audio stamped with *clock
+	struct audio *audio;
+	const uint64_t *clock;
+};
+
+// the cabinet's buttons, as bits of a mask
+enum invaders_button {
+	INVADERS_COIN,
+	INVADERS_P1_START,
+	INVADERS_P2_START,
+	INVADERS_P1_FIRE,
+	INVADERS_P1_LEFT,
+	INVADERS_P1_RIGHT,
+	INVADERS_P2_FIRE,
+	INVADERS_P2_LEFT,
+	INVADERS_P2_RIGHT,
+};
+
+// hooks the board up to ports, with io as their context. The switches are
+// plain values in ports->value[0-2].
+void invaders_io_init(struct invaders_io *io, struct ports *ports);
+
+// set input ports 1 and 2 to the buttons held down in the mask
+void invaders_buttons(struct ports *ports, uint32_t buttons);
+
+// register the native versions of the ROM's hottest routines (invaders_hle.c)
+// with hle, those whose code is found in memory. Returns how many were.
+int invaders_hle(struct hle *hle, const uint8_t *memory);
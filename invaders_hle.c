@@ -0,0 +1,180 @@
+#include <stddef.h> // size_t
+#include <string.h> // memset
+
+#include "8080.h"
+#include "hle.h"
+#include "invaders.h"
+
+// Native versions of the hottest routines of the Space Invaders ROM, named
+// as in the usual disassembly. Where a source, a destination or the stack
+// could overlap they go byte by byte in the same order as the loop does.
+
+static void poke(struct i8080 *cpu, uint8_t *memory, uint16_t addr, uint8_t v) {
+	memory[addr] = v;
+	memory_written(cpu, addr, 1);
+}
+
+static void ret(struct i8080 *cpu, uint8_t *memory) {
+	cpu->pc = memory[cpu->sp] | memory[(uint16_t)(cpu->sp + 1)] << 8;
+	cpu->sp += 2;
+	cpu->clock_cnt += 10;
+}
+
+// DCR B down to 0, CY is left alone
+static void dcr_to_zero(struct i8080 *cpu) {
+	setFlag(cpu, Z, 1);
+	setFlag(cpu, S, 0);
+	setFlag(cpu, P, 1);
+	setFlag(cpu, AC, 1);
+}
+
+// copy B bytes from DE to HL
+static const uint8_t block_copy_code[] = {
+	0x1a,             // LDAX D
+	0x77,             // MOV M,A
+	0x23,             // INX H
+	0x13,             // INX D
+	0x05,             // DCR B
+	0xc2, 0x32, 0x1a, // JNZ $1A32
+	0xc9,             // RET
+};
+
+static int block_copy(struct i8080 *cpu, uint8_t *memory, uint64_t until) {
+	const uint32_t n = cpu->B ? cpu->B : 0x100;
+	if(cpu->clock_cnt + n * 39 + 10 > until) return 0;
+
+	uint16_t hl = rpHL(cpu), de = rpDE(cpu);
+	for(uint32_t i = 0;i < n;i ++) {
+		cpu->A = memory[de ++];
+		poke(cpu, memory, hl ++, cpu->A);
+	}
+	srpHL(cpu, hl);
+	srpDE(cpu, de);
+	cpu->B = 0;
+	dcr_to_zero(cpu);
+	cpu->clock_cnt += n * 39;
+	ret(cpu, memory);
+	return 1;
+}
+
+// zero all of VRAM. The loop is hooked too, so that a clear cut short by
+// until carries on natively from where it got to.
+static const uint8_t clear_screen_code[] = {
+	0x21, 0x00, 0x24, // LXI H,$2400
+	0x36, 0x00,       // MVI M,$00
+	0x23,             // INX H
+	0x7c,             // MOV A,H
+	0xfe, 0x40,       // CPI $40
+	0xc2, 0x5f, 0x1a, // JNZ $1A5F
+	0xc9,             // RET
+};
+
+// from the loop head at $1A5F, HL is where it got to
+static int clear_loop(struct i8080 *cpu, uint8_t *memory, uint64_t until) {
+	const uint16_t hl = rpHL(cpu);
+	if(hl < 0x2000 || hl >= 0x4000) return 0;
+	const uint32_t n = 0x4000 - hl;
+
+	if(cpu->clock_cnt + n * 37 + 10 <= until) {
+		memset(memory + hl, 0, n);
+		memory_written(cpu, hl, n);
+		srpHL(cpu, 0x4000);
+		cpu->A = 0x40;
+		// CPI $40 with A = $40
+		setFlag(cpu, Z, 1);
+		setFlag(cpu, S, 0);
+		setFlag(cpu, P, 1);
+		setFlag(cpu, CY, 0);
+		setFlag(cpu, AC, 1);
+		cpu->clock_cnt += n * 37;
+		ret(cpu, memory);
+		return 1;
+	}
+
+	// as far as until allows, the last time around is interpreted to get A
+	// and the flags right
+	const uint64_t fit = (until - cpu->clock_cnt) / 37;
+	if(fit < 2) return 0;
+	const uint32_t k = fit - 1;
+	memset(memory + hl, 0, k);
+	memory_written(cpu, hl, k);
+	srpHL(cpu, hl + k);
+	cpu->clock_cnt += k * 37;
+	for(int i = 0;i < 5;i ++) execute_instruction(cpu, memory);
+	return 1;
+}
+
+static int clear_screen(struct i8080 *cpu, uint8_t *memory, uint64_t until) {
+	if(cpu->clock_cnt + 10 > until) return 0;
+	srpHL(cpu, 0x2400);
+	cpu->pc = 0x1a5f;
+	cpu->clock_cnt += 10;
+	clear_loop(cpu, memory, until);
+	return 1;
+}
+
+// draw a sprite of B bytes from DE, one byte per row: HL goes down a
+// column of VRAM 32 bytes at a time
+static const uint8_t draw_simple_sprite_code[] = {
+	0xc5,             // PUSH B
+	0x1a,             // LDAX D
+	0x77,             // MOV M,A
+	0x13,             // INX D
+	0x01, 0x20, 0x00, // LXI B,$0020
+	0x09,             // DAD B
+	0xc1,             // POP B
+	0x05,             // DCR B
+	0xc2, 0x39, 0x14, // JNZ $1439
+	0xc9,             // RET
+};
+
+static int draw_simple_sprite(struct i8080 *cpu, uint8_t *memory, uint64_t until) {
+	const uint32_t n = cpu->B ? cpu->B : 0x100;
+	if(cpu->clock_cnt + n * 75 + 10 > until) return 0;
+
+	// a sprite drawn over the pushed BC would change how often it loops,
+	// that is left to the interpreter
+	const uint16_t hl = rpHL(cpu), sp = cpu->sp;
+	for(int i = 1;i <= 2;i ++) {
+		const uint16_t off = (uint16_t)(sp - i) - hl;
+		if(off % 0x20 == 0 && off / 0x20 < n) return 0;
+	}
+
+	uint16_t dst = hl, de = rpDE(cpu);
+	uint8_t b = cpu->B, c = cpu->C;
+	int carry = 0;
+	for(uint32_t i = 0;i < n;i ++) {
+		poke(cpu, memory, sp - 1, b);
+		poke(cpu, memory, sp - 2, c);
+		cpu->A = memory[de ++];
+		poke(cpu, memory, dst, cpu->A);
+		carry = dst + 0x20 > 0xFFFF;
+		dst += 0x20;
+		c = memory[(uint16_t)(sp - 2)];
+		b = memory[(uint16_t)(sp - 1)] - 1;
+	}
+	srpHL(cpu, dst);
+	srpDE(cpu, de);
+	cpu->B = b;
+	cpu->C = c;
+	dcr_to_zero(cpu);
+	setFlag(cpu, CY, carry);
+	cpu->clock_cnt += n * 75;
+	ret(cpu, memory);
+	return 1;
+}
+
+#define HOOK(name, addr, code, run) {name, addr, code, sizeof(code), run}
+static const struct hle_hook hooks[] = {
+	HOOK("BlockCopy", 0x1a32, block_copy_code, block_copy),
+	HOOK("ClearScreen", 0x1a5c, clear_screen_code, clear_screen),
+	{"ClearScreen loop", 0x1a5f, clear_screen_code + 3, sizeof(clear_screen_code) - 3, clear_loop},
+	HOOK("DrawSimpSprite", 0x1439, draw_simple_sprite_code, draw_simple_sprite),
+};
+#undef HOOK
+
+int invaders_hle(struct hle *hle, const uint8_t *memory) {
+	int added = 0;
+	for(size_t i = 0;i < sizeof(hooks) / sizeof(hooks[0]);i ++) added += hle_add(hle, &hooks[i], memory) == 0;
+	return added;
+}
@@ -0,0 +1,142 @@
+#include <stdlib.h> // malloc
+#include <string.h> // memcpy
+
+#include "machine.h"
+#include "flight.h"
+#include "mem.h"
+#include "pace.h"
+
+int machine_init(struct machine *m, const char *rom, const char *flight_log) {
+	struct i8080 *cpu = &m->cpu;
+	memset(cpu, 0, sizeof(struct i8080));
+	cpu->recorder = calloc(1, sizeof(struct flight_recorder));
+	flight_install(cpu->recorder, flight_log);
+
+	invaders_io_init(&m->io, &m->ports);
+	cpu->ports = &m->ports;
+
+	// a frame of cycles takes exactly 1/60 s, so that the samples made per
+	// frame match what the sound card plays in that time
+	audio_init(&m->audio, CYCLES_PER_FRAME * FPS, FPS);
+	m->io.clock = &cpu->clock_cnt;
+
+	// the ROM is mapped read only at 0, the RAM after it is ours
+	m->memory = mem_create();
+	if(m->memory == NULL) return -2;
+	if(mem_load(m->memory, rom, 0, 0) < 0) return -1;
+
+	// everything starts dirty, nothing was shown yet
+	cpu->dirty = malloc(DIRTY_SIZE);
+	memset(cpu->dirty, 1, DIRTY_SIZE);
+	triple_init(&m->frames);
+
+	atomic_init(&m->turbo, 0);
+	atomic_init(&m->running, 1);
+	atomic_init(&m->buttons, 0);
+	return 0;
+}
+
+void machine_free(struct machine *m) {
+	mem_destroy(m->memory);
+	free(m->cpu.dirty);
+}
+
+// copy columns x0 to x1 of VRAM, and which of them changed, into the frame
+// being put together
+static void snapshot(struct machine *m, int x0, int x1) {
+	struct frame *frame = triple_back(&m->frames);
+	uint8_t *cols = m->cpu.dirty + (FB_VRAM >> DIRTY_SHIFT); // a VRAM column is one dirty block
+
+	memcpy(frame->vram + x0 * FB_COLUMN, m->memory + FB_VRAM + x0 * FB_COLUMN, (x1 - x0) * FB_COLUMN);
+	memcpy(frame->dirty + x0, cols + x0, x1 - x0);
+	memset(cols + x0, 0, x1 - x0);
+}
+
+// like snapshot, for the capture
+static void record(struct machine *m, int x0, int x1) {
+	if(m->capture == NULL) return;
+	if(x0 == 0) m->capturing = capture_frame(m->capture);
+	if(m->capturing == NULL) return;
+
+	memcpy(m->capturing + x0 * FB_COLUMN, m->memory + FB_VRAM + x0 * FB_COLUMN, (x1 - x0) * FB_COLUMN);
+	if(x1 == FB_WIDTH) capture_submit(m->capture);
+}
+
+// whether the frame about to be run is going to be shown. The others are
+// never copied out, their dirty columns carry over to the next shown one.
+static int shown(struct machine *m, int turbo, uint32_t frame, uint64_t *last) {
+	if(!turbo) return 1;
+	if(m->skip) return frame % m->skip == 0;
+
+	const uint64_t now = pace_now();
+	if(now - *last < m->refresh_ns) return 0;
+	*last = now;
+	return 1;
+}
+
+void *machine_run(void *arg) {
+	struct machine *m = arg;
+	struct i8080 *cpu = &m->cpu;
+
+	// the beam position is counted in emulated cycles. RST 1 comes when it
+	// reaches the middle of the screen, RST 2 when it starts the vertical
+	// blank, and each time the half it has just finished is copied out
+	uint64_t frame_start = 0;
+	uint64_t next_interrupt = frame_start + CYCLES_MID;
+	uint32_t frame = 0, published = 0;
+	struct pace pace;
+	pace_init(&pace, FPS, m->speed);
+
+	// the hooks are called from here, so blocks have to stop at them
+	if(m->blocks && m->hle) {
+		for(uint32_t i = 0;i < m->hle->nhooks;i ++) block_stop(m->blocks, m->hle->hooks[i]->addr);
+	}
+
+	int turbo = atomic_load(&m->turbo);
+	uint64_t last_shown = 0;
+	int show = 1;
+	while(getFlag(cpu, HLT) == 0 && atomic_load_explicit(&m->running, memory_order_relaxed)) {
+		if(m->hle == NULL || !hle_call(m->hle, cpu, m->memory, next_interrupt)) {
+			if(m->blocks) block_run(m->blocks, cpu, m->memory, next_interrupt);
+			else execute_instruction(cpu, m->memory);
+		}
+		if(cpu->clock_cnt < next_interrupt) continue;
+
+		if(next_interrupt == frame_start + CYCLES_MID) {
+			request_interrupt(cpu, m->memory, 1);
+			if(show) snapshot(m, 0, SCANLINE_MID);
+			record(m, 0, SCANLINE_MID);
+			next_interrupt = frame_start + CYCLES_END;
+			continue;
+		}
+
+		request_interrupt(cpu, m->memory, 2);
+		if(m->io.audio) audio_run(m->io.audio, cpu->clock_cnt);
+		record(m, SCANLINE_MID, FB_WIDTH);
+		if(show) {
+			snapshot(m, SCANLINE_MID, FB_WIDTH);
+			published ++;
+			triple_back(&m->frames)->seq = published;
+			triple_publish(&m->frames);
+		}
+
+		frame ++;
+		frame_start += CYCLES_PER_FRAME;
+		next_interrupt = frame_start + CYCLES_MID;
+		if(frame == m->frame_limit) break;
+
+		// input only changes here, once a frame at the start of the vertical
+		// blank, so a run depends on the buttons of each frame and nothing else
+		invaders_buttons(&m->ports, atomic_load_explicit(&m->buttons, memory_order_relaxed));
+
+		const int was_turbo = turbo;
+		turbo = atomic_load_explicit(&m->turbo, memory_order_relaxed);
+		if(!turbo && was_turbo) pace_restart(&pace);
+		if(!turbo) pace_frame(&pace);
+		show = shown(m, turbo, frame, &last_shown);
+	}
+
+	flags_flush(cpu);
+	atomic_store(&m->running, 0);
+	return NULL;
+}
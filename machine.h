@@ -0,0 +1,55 @@
+#include <stdint.h> // uint8_t, uint32_t, uint64_t
+#include <stdatomic.h>
+
+#include "8080.h"
+#include "invaders.h"
+#include "audio.h"
+#include "triple.h"
+#include "capture.h"
+#include "block.h"
+#include "hle.h"
+
+// The Space Invaders machine: the CPU, its memory and ports, the video
+// timing and where the frames and sound go. It runs on a thread of its own,
+// the frontend only talks to it through the atomics and the triple buffer.
+
+// video timing: a 2 MHz CPU and 60 frames of 262 scanlines, 224 of which
+// are visible. A scanline of the (rotated) monitor is a column of VRAM.
+#define CPU_HZ 2000000
+#define FPS 60
+#define CYCLES_PER_FRAME (CPU_HZ / FPS)
+#define SCANLINES 262
+#define SCANLINE_MID 96
+#define CYCLES_MID (SCANLINE_MID * CYCLES_PER_FRAME / SCANLINES)
+#define CYCLES_END (FB_WIDTH * CYCLES_PER_FRAME / SCANLINES)
+
+struct machine {
+	struct i8080 cpu;
+	uint8_t *memory;
+	struct invaders_io io;
+	struct ports ports;
+	struct audio audio; // only used when io.audio points at it
+	struct triple frames; // finished frames for the frontend
+	struct capture *capture; // optional, every frame gets recorded
+	struct blocks *blocks; // optional, run a block at a time, see block.h
+	struct hle *hle; // optional, native versions of some routines
+	uint8_t *capturing; // the capture slot of the current frame, NULL if it is dropped
+	double speed; // see pace.h
+	uint32_t skip; // when fast forwarding, show every skip-th frame. 0 - as often as the display refreshes
+	uint64_t refresh_ns; // the display's refresh period
+	uint32_t frame_limit; // stop after this many frames, 0 - never
+
+	atomic_int turbo; // fast forward: unthrottled, only some frames are shown
+	atomic_int running;
+	atomic_uint buttons; // held down right now, see enum invaders_button
+};
+
+// sets everything up for the ROM at path, returns -1 if it can't be loaded,
+// -2 if out of memory.
+// The flight recorder is dumped to flight_log on a crash, see flight.h.
+int machine_init(struct machine *m, const char *rom, const char *flight_log);
+void machine_free(struct machine *m);
+
+// the emulation thread, runs until the CPU halts, the frame limit is
+// reached or running is cleared
+void *machine_run(void *arg);
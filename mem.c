@@ -0,0 +1,73 @@
+#define _GNU_SOURCE // memfd_create
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <fcntl.h> // open
+#include <unistd.h> // pread, sysconf
+
+#include "mem.h"
+
+// map the same pages (file or memfd) at addr in both copies
+static int map_twice(uint8_t *mem, size_t addr, size_t len, int prot, int flags, int fd, off_t off) {
+	if(mmap(mem + addr, len, prot, flags | MAP_FIXED, fd, off) == MAP_FAILED) return -1;
+	if(mmap(mem + MEM_SIZE + addr, len, prot, flags | MAP_FIXED, fd, off) == MAP_FAILED) return -1;
+	return 0;
+}
+
+uint8_t *mem_create(void) {
+	// reserve the whole 128 KiB first so nothing else can land in between
+	uint8_t *mem = mmap(NULL, 2 * MEM_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(mem == MAP_FAILED) return NULL;
+
+	const int fd = memfd_create("i8080", MFD_CLOEXEC);
+	if(fd < 0 || ftruncate(fd, MEM_SIZE) != 0
+	|| map_twice(mem, 0, MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) != 0) {
+		if(fd >= 0) close(fd);
+		munmap(mem, 2 * MEM_SIZE);
+		return NULL;
+	}
+
+	// the mappings keep the memfd alive
+	close(fd);
+	return mem;
+}
+
+void mem_destroy(uint8_t *mem) {
+	munmap(mem, 2 * MEM_SIZE);
+}
+
+ssize_t mem_load(uint8_t *mem, const char *path, uint16_t addr, int writable) {
+	const int fd = open(path, O_RDONLY);
+	if(fd < 0) return -1;
+
+	struct stat sb;
+	if(fstat(fd, &sb) == -1 || sb.st_size > MEM_SIZE - addr) {
+		close(fd);
+		return -1;
+	}
+	const size_t size = sb.st_size;
+
+	// only whole pages can be mapped, a partial last page would leave the
+	// rest of that page read only
+	const size_t page = sysconf(_SC_PAGESIZE);
+	size_t mapped = 0;
+	if(!writable && addr % page == 0) {
+		mapped = size - size % page;
+		if(mapped > 0 && map_twice(mem, addr, mapped, PROT_READ, MAP_PRIVATE, fd, 0) != 0) {
+			close(fd);
+			return -1;
+		}
+	}
+
+	size_t done = mapped;
+	while(done < size) {
+		const ssize_t n = pread(fd, mem + addr + done, size - done, done);
+		if(n <= 0) {
+			close(fd);
+			return -1;
+		}
+		done += n;
+	}
+
+	close(fd);
+	return size;
+}
@@ -0,0 +1,24 @@
+#include <stdint.h> // uint8_t, uint16_t
+#include <sys/types.h> // ssize_t
+
+// Guest memory is a 64 KiB mapping of its own. Files loaded at a page
+// aligned address are mapped straight from the page cache instead of being
+// copied, so instances running the same ROM share it and a read only ROM
+// can't be written to by the guest.
+//
+// The 64 KiB are mapped twice back to back, mem[0x10000 + x] is mem[x].
+// That way an access that runs past 0xFFFF wraps around to 0 just like on
+// the real bus, without the core having to mask anything.
+
+#define MEM_SIZE 0x10000
+
+// a fresh 64 KiB of zeroed RAM, followed by its mirror. NULL if it can't be
+// mapped.
+uint8_t *mem_create(void);
+void mem_destroy(uint8_t *mem);
+
+// put the contents of path at addr. When writable is not set, whole pages
+// are mapped read only from the file. Anything else is copied, a private
+// copy on write mapping would stop matching its mirror after a write.
+// Returns the file size or -1.
+ssize_t mem_load(uint8_t *mem, const char *path, uint16_t addr, int writable);
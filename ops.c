@@ -0,0 +1,7 @@
+#include "ops.h"
+
+const struct opinfo ops[256] = {
+#define X(op, fmt, len, cycles, taken, reads, writes, access, flow) [op] = {fmt, len, cycles, taken, reads, writes, access, flow},
+	OPCODES(X)
+#undef X
+};
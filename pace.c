@@ -0,0 +1,51 @@
+#include <errno.h> // EINTR
+
+#include "pace.h"
+
+#define NS 1000000000ULL
+
+// further behind than this and we start counting again from now, instead of
+// running flat out until the lost time is made up
+#define PACE_MAX_BEHIND (NS / 4)
+
+static uint64_t ns(const struct timespec *ts) {
+	return ts->tv_sec * NS + ts->tv_nsec;
+}
+
+void pace_init(struct pace *pace, double fps, double speed) {
+	clock_gettime(CLOCK_MONOTONIC, &pace->start);
+	pace->frames = 0;
+	pace->frame_ns = speed > 0 ? NS / (fps * speed) : 0;
+	pace->resyncs = 0;
+}
+
+void pace_frame(struct pace *pace) {
+	pace->frames ++;
+	if(pace->frame_ns == 0) return;
+
+	const uint64_t due = ns(&pace->start) + pace->frames * pace->frame_ns;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if(ns(&now) > due + PACE_MAX_BEHIND) {
+		// the host was busy or we got stopped, pretend this frame was on time
+		pace->start = now;
+		pace->frames = 0;
+		pace->resyncs ++;
+		return;
+	}
+
+	const struct timespec until = {due / NS, due % NS};
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR);
+}
+
+void pace_restart(struct pace *pace) {
+	clock_gettime(CLOCK_MONOTONIC, &pace->start);
+	pace->frames = 0;
+}
+
+uint64_t pace_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ns(&now);
+}
@@ -0,0 +1,29 @@
+#include <stdint.h> // uint64_t
+#include <time.h> // struct timespec
+
+// Keeps an emulator at a given speed: run a frame's worth of cycles, then
+// call pace_frame, which sleeps until that frame is due. Deadlines are
+// absolute, counted from one starting point, so oversleeping once doesn't
+// add up over time.
+
+#define PACE_UNTHROTTLED 0.0
+#define PACE_REALTIME 1.0
+
+struct pace {
+	struct timespec start; // when frame 0 was due
+	uint64_t frames; // frames done since start
+	uint64_t frame_ns; // length of a frame at the chosen speed, 0 when unthrottled
+	uint64_t resyncs; // times we fell too far behind and gave up catching up
+};
+
+// speed is a multiple of real time (2 runs twice as fast), or PACE_UNTHROTTLED
+void pace_init(struct pace *pace, double fps, double speed);
+
+// one more frame is done, wait until the next one should start
+void pace_frame(struct pace *pace);
+
+// count from now on, after frames were run without calling pace_frame
+void pace_restart(struct pace *pace);
+
+// CLOCK_MONOTONIC in nanoseconds
+uint64_t pace_now(void);
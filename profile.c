@@ -0,0 +1,77 @@
+#include <stdlib.h> // qsort
+#include <string.h> // strcspn
+
+#include "profile.h"
+#include "ops.h"
+
+static const char *flows[] = {
+	[FLOW_NONE] = "straight",
+	[FLOW_JUMP] = "jump",
+	[FLOW_BRANCH] = "branch",
+	[FLOW_CALL] = "call",
+	[FLOW_CALL_COND] = "conditional call",
+	[FLOW_RST] = "rst",
+	[FLOW_RET] = "return",
+	[FLOW_RET_COND] = "conditional return",
+	[FLOW_INDIRECT] = "pchl",
+	[FLOW_HALT] = "halt",
+	[FLOW_INVALID] = "invalid",
+};
+
+static const uint64_t *sorting;
+static int by_count(const void *a, const void *b) {
+	const uint64_t x = sorting[*(const uint8_t *)a], y = sorting[*(const uint8_t *)b];
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// the format without its operand, "MVI B, $%02x" is "MVI B"
+static void mnemonic(char *out, size_t len, const char *fmt) {
+	size_t n = strcspn(fmt, "%");
+	while(n > 0 && strchr(" ,$#", fmt[n - 1])) n --;
+	if(n >= len) n = len - 1;
+	memcpy(out, fmt, n);
+	out[n] = '\0';
+}
+
+static double percent(uint64_t part, uint64_t total) {
+	return total ? 100.0 * part / total : 0;
+}
+
+void profile_report(FILE *f, const uint64_t counts[256], int top) {
+	uint64_t total = 0, cycles = 0;
+	uint64_t flow[FLOW_INVALID + 1] = {0};
+	uint64_t reads = 0, writes = 0, stack = 0, io = 0, flags = 0;
+	for(int op = 0;op < 256;op ++) {
+		const struct opinfo *o = &ops[op];
+		total += counts[op];
+		cycles += counts[op] * o->cycles;
+		flow[o->flow] += counts[op];
+		if(o->access & ACC_READ) reads += counts[op];
+		if(o->access & ACC_WRITE) writes += counts[op];
+		if(o->access & ACC_STACK) stack += counts[op];
+		if(o->access & ACC_IO) io += counts[op];
+		if(o->writes) flags += counts[op];
+	}
+
+	uint8_t order[256];
+	for(int i = 0;i < 256;i ++) order[i] = i;
+	sorting = counts;
+	qsort(order, 256, 1, by_count);
+
+	fprintf(f, "%llu instructions, at least %llu cycles\n", (unsigned long long)total, (unsigned long long)cycles);
+	fprintf(f, "%-4s %-10s %14s %7s %7s\n", "op", "", "count", "%", "cycles%");
+	for(int i = 0;i < top && i < 256 && counts[order[i]];i ++) {
+		const uint8_t op = order[i];
+		char name[16];
+		mnemonic(name, sizeof(name), ops[op].fmt);
+		fprintf(f, "%02x   %-10s %14llu %7.2f %7.2f\n", op, name, (unsigned long long)counts[op],
+				percent(counts[op], total), percent(counts[op] * ops[op].cycles, cycles));
+	}
+
+	fprintf(f, "by control flow:\n");
+	for(int i = 0;i <= FLOW_INVALID;i ++) {
+		if(flow[i]) fprintf(f, "  %-20s %14llu %7.2f\n", flows[i], (unsigned long long)flow[i], percent(flow[i], total));
+	}
+	fprintf(f, "memory reads %.2f%%, writes %.2f%%, stack %.2f%%, I/O %.2f%%, flag writes %.2f%%\n",
+			percent(reads, total), percent(writes, total), percent(stack, total), percent(io, total), percent(flags, total));
+}
@@ -0,0 +1,9 @@
+#include <stdint.h> // uint64_t
+#include <stdio.h> // FILE
+
+// Instruction mix of a run, from how often each opcode was executed. All
+// the opcode facts come from ops.h.
+
+// the top opcodes, then the totals by control flow and memory access.
+// Cycles for conditional calls and returns are counted as not taken.
+void profile_report(FILE *f, const uint64_t counts[256], int top);
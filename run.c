@@ -1,79 +1,81 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h> // fstat
-#include <fcntl.h> // open
-#include <sys/mman.h> // mmap
+#include <unistd.h> // STDOUT_FILENO, getopt
 
 #include "8080.h"
-
-void debugp(struct i8080* cpu, char* buff) {
-	char flags[] = ".....";
-	if(getFlag(cpu, Z )) flags[Z ] = 'Z';
-	if(getFlag(cpu, S )) flags[S ] = 'S';
-	if(getFlag(cpu, P )) flags[P ] = 'P';
-	if(getFlag(cpu, CY)) flags[CY] = 'C';
-	if(getFlag(cpu, AC)) flags[AC] = 'A';
-
-	sprintf(buff, "A=%02x, BC=%04x, DE=%04x, HL=%04x, pc=%04x, sp=%04x, flags=%s\n",
-		cpu->A, rpBC(cpu), rpDE(cpu), rpHL(cpu), cpu->pc, cpu->sp, flags);
-}
-
-void out(uint8_t port, uint8_t data) {
-	printf("OUT on port %02x: %02x\n", port, data);
-}
+#include "cpm.h"
+#include "block.h"
+#include "flight.h"
+#include "mem.h"
+#include "profile.h"
 
 int main(int argc, char** argv) {
-	if(argc < 2) {
-		printf("Usage: %s ROM filename\n", argv[0]);
+	int profile = 0;
+	int blocks = 0;
+	const char *flight_log = NULL;
+
+	int opt;
+	while((opt = getopt(argc, argv, "pbr:")) != -1) {
+		switch(opt) {
+			case 'p': profile = 1; break;
+			case 'b': blocks = 1; break;
+			case 'r': flight_log = optarg; break;
+			default: optind = argc; break;
+		}
+	}
+	if(optind >= argc) {
+		printf("Usage: %s [-p] [-b] [-r file] COM filename\n", argv[0]);
+		printf("  -p    print the instruction mix to stderr at the end\n");
+		printf("  -b    run a block at a time, skipping flags nobody reads, and print\n");
+		printf("        how many blocks were decoded to stderr at the end\n");
+		printf("  -r F  write the last instructions run to F if the program crashes\n");
 		return 1;
 	}
+	const char *path = argv[optind];
 
-	const int fd = open(argv[1], O_RDONLY);
+	struct i8080 cpu;
+	memset(&cpu, 0, sizeof(struct i8080));
+	cpu.recorder = calloc(1, sizeof(struct flight_recorder));
+	flight_install(cpu.recorder, flight_log);
 
-	if(fd < 0) {
-		printf("Failed to open %s\n", argv[1]);
+	// .COM files go to 0x100 which isn't page aligned, so this ends up a copy
+	uint8_t* memory = mem_create();
+	if(memory == NULL) {
+		printf("Out of memory\n");
 		return 1;
 	}
-
-	struct stat sb;
-	if(fstat(fd, &sb) == -1) {
-		printf("Couldn't get file size of %s\n", argv[1]);
+	const ssize_t size = mem_load(memory, path, CPM_TPA, 1);
+	if(size < 0) {
+		printf("Failed to load %s\n", path);
 		return 1;
 	}
-
-	unsigned char* bytecode = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-	if(bytecode == MAP_FAILED) {
-		printf("Couldn't mmap %s\n", argv[1]);
+	if(size > CPM_MAX_COM) {
+		printf("%s is too big for a CP/M TPA\n", path);
 		return 1;
 	}
+	cpm_setup(memory);
+
+	struct cpm cpm;
+	cpm_init(&cpm, &cpu, memory, STDOUT_FILENO);
+	static uint64_t counts[256];
+	if(profile) cpm.profile = counts;
+	if(blocks) {
+		cpm.blocks = blocks_create();
+		if(cpm.blocks == NULL) {
+			printf("Out of memory\n");
+			return 1;
+		}
+	}
 
-	struct i8080 cpu;
-	memset(&cpu, 0, sizeof(struct i8080));
-
-	uint8_t* memory = calloc(64000, sizeof(uint8_t));
-	// load executable into memory
-	memcpy(memory, bytecode, sb.st_size);
-
-	// 0x5 is special print routine in CP/M
-	memory[5] = 0x10; // DEB
-	memory[6] = 0xc9; // RET
-
-	// jump to 0x100
-	memory[0]=0xc3;
-	memory[1]=0;
-	memory[2]=0x01;
-
-	// fix SP
-	memory[368] = 0x7;
-
-
-	char* d8 = malloc(100);
-
-	while(1) {
-		execute_instruction(&cpu, memory, out);
-
-		debugp(&cpu, d8);
-		printf("%s", d8);
+	const int status = cpm_run(&cpm, &cpu, memory);
+	// the program's last line may not have ended
+	if(profile || cpm.blocks) fprintf(stderr, "\n");
+	if(profile) profile_report(stderr, counts, 20);
+	if(cpm.blocks) blocks_report(stderr, cpm.blocks);
+	if(status != CPM_EXIT) {
+		fprintf(stderr, "\nProgram stopped (status %d) after %d instructions, pc=%04x\n",
+				status, cpu.instr, cpu.pc);
 	}
+	return status;
 }
@@ -1,187 +1,182 @@
-#include <sys/stat.h> // fstat
-#include <fcntl.h> // open
-#include <sys/mman.h> // mmap
-#include <SDL2/SDL.h>
-#include <time.h>
-
-#include "8080.h"
-
-void debugp(struct i8080* cpu) {
-	char flags[] = ".....";
-	if(getFlag(cpu, Z )) flags[Z ] = 'Z';
-	if(getFlag(cpu, S )) flags[S ] = 'S';
-	if(getFlag(cpu, P )) flags[P ] = 'P';
-	if(getFlag(cpu, CY)) flags[CY] = 'C';
-	if(getFlag(cpu, AC)) flags[AC] = 'A';
-
-	printf("%04d) A=%02x, BC=%04x, DE=%04x, HL=%04x, pc=%04x, sp=%04x, flags=%s\n",
-			cpu->instr, cpu->A, rpBC(cpu), rpDE(cpu), rpHL(cpu), cpu->pc, cpu->sp, flags);
-}
-
-void out(uint8_t port, uint8_t data) {
-	printf("OUT %02x: %02x\n", port, data);
-}
-
-void drawFBToSDL(uint8_t *fb, uint8_t *sdlbuf) {
-	// 7168 bytes to be read from the fb - 224x256 pixels, 1 bit per pixel
-
-	uint8_t pgid = 0;
-	for(int sdlx = 0;sdlx < 224;sdlx ++) {
-		for(int sdly = 255;sdly >= 0;sdly --) {
-			const int sdl_pixel_idx = sdly * 224 + sdlx;
-
-			const uint8_t fbColor = ( (*fb) >> pgid ) & 1;
-			pgid ++;
-
-			if(pgid == 8) {
-				fb ++;
-				pgid = 0;
-			}
-
-			/* I thought this would be faster:
-			 *
-			 *    fb += (pgid >> 3);
-			 *    pgid &= 0b0111;
-			 *
-			 * But it looks like my Ryzen 5 3500U is correctly predicting it
-			 * can be skipped when there is branching.
-			*/
-
-			sdlbuf[sdl_pixel_idx * 4 + 0] = fbColor * 255;
-			sdlbuf[sdl_pixel_idx * 4 + 1] = fbColor * 255;
-			sdlbuf[sdl_pixel_idx * 4 + 2] = fbColor * 255;
-			sdlbuf[sdl_pixel_idx * 4 + 3] = SDL_ALPHA_OPAQUE;
-		}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h> // getopt, usleep
+
+#include "machine.h"
+#include "pace.h"
+#include "backend.h"
+
+// where frames and input can come from, the first one is the default
+static const struct backend *backends[] = {
+#ifdef WITH_SDL
+	&backend_sdl,
+#endif
+	&backend_null,
+};
+#define BACKEND_COUNT (sizeof(backends) / sizeof(backends[0]))
+
+static const struct backend *find_backend(const char *name) {
+	for(size_t i = 0;i < BACKEND_COUNT;i ++) {
+		if(strcmp(backends[i]->name, name) == 0) return backends[i];
 	}
+	return NULL;
 }
 
 int main(int argc, char** argv) {
-	if(argc < 2) {
-		printf("Usage: %s ROM filename\n", argv[0]);
+	static struct machine m;
+	m.speed = PACE_REALTIME;
+	const char *wav = NULL;
+	const char *capture = NULL;
+	const char *flight_log = NULL;
+	const struct backend *backend = backends[0];
+	struct backend_options options = {1, 0};
+	int turbo = 0;
+	int blocks = 0;
+	int hle = 0; // 1 - hooks, 2 - checked too
+
+	int opt;
+	while((opt = getopt(argc, argv, "s:uw:fn:x:mc:b:t:keEr:")) != -1) {
+		switch(opt) {
+			case 'b': backend = find_backend(optarg); break;
+			case 't': m.frame_limit = strtoul(optarg, NULL, 0); break;
+			case 'c': capture = optarg; break;
+			case 'x': options.scale = atoi(optarg); break;
+			case 'm': options.mono = 1; break;
+			case 'f': turbo = 1; break;
+			case 'n': m.skip = strtoul(optarg, NULL, 0); break;
+			case 's': m.speed = strtod(optarg, NULL); break;
+			case 'u': m.speed = PACE_UNTHROTTLED; break;
+			case 'w': wav = optarg; break;
+			case 'k': blocks = 1; break;
+			case 'e': hle = 1; break;
+			case 'E': hle = 2; break;
+			case 'r': flight_log = optarg; break;
+			default: optind = argc; break;
+		}
+	}
+	if(optind >= argc || backend == NULL || m.speed < 0 || options.scale < 1 || options.scale > FB_MAX_SCALE) {
+		printf("Usage: %s [-b backend] [-s speed | -u] [-w file] [-f] [-n N] [-x N] [-m] [-c file] [-t N] [-k] [-e | -E] [-r file] ROM filename\n", argv[0]);
+		printf("  -b B  where the picture, the input and the sound go:");
+		for(size_t i = 0;i < BACKEND_COUNT;i ++) printf(" %s", backends[i]->name);
+		printf("\n");
+		printf("  -s N  run at N times the speed of the real machine\n");
+		printf("  -u    run as fast as possible\n");
+		printf("  -w F  write the sound to a WAV file instead of playing it\n");
+		printf("  -f    start fast forwarding, Tab switches it on and off\n");
+		printf("  -n N  when fast forwarding, show every Nth frame instead of\n");
+		printf("        one per display refresh\n");
+		printf("  -x N  draw every pixel as an N x N block (up to %d)\n", FB_MAX_SCALE);
+		printf("  -m    black and white, without the colored overlay\n");
+		printf("  -c F  record every frame to F (a file or a pipe), as YUV4MPEG2\n");
+		printf("        if the name ends in .y4m, raw 1 bit VRAM otherwise\n");
+		printf("  -t N  stop after N frames\n");
+		printf("  -k    run a block at a time, with copy and fill loops done natively\n");
+		printf("  -e    run some of the ROM's routines natively\n");
+		printf("  -E    the same, checking every call against the interpreter\n");
+		printf("  -r F  write the last instructions run to F if the emulator crashes\n");
 		return 1;
 	}
 
-	const int fd = open(argv[1], O_RDONLY);
-
-	if(fd < 0) {
-		printf("Failed to open %s\n", argv[1]);
+	const char *rom = argv[optind];
+	const int loaded = machine_init(&m, rom, flight_log);
+	if(loaded != 0) {
+		if(loaded == -2) printf("Out of memory\n");
+		else printf("Failed to load %s\n", rom);
 		return 1;
 	}
 
-	struct stat sb;
-	if(fstat(fd, &sb) == -1) {
-		printf("Couldn't get file size of %s\n", argv[1]);
-		return 1;
+	if(blocks) {
+		m.blocks = blocks_create();
+		if(m.blocks == NULL) {
+			printf("Out of memory\n");
+			return 1;
+		}
 	}
 
-	unsigned char* bytecode = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-	if(bytecode == MAP_FAILED) {
-		printf("Couldn't mmap %s\n", argv[1]);
-		return 1;
+	static struct hle hooks;
+	if(hle) {
+		if(hle_init(&hooks, hle == 2) != 0) {
+			printf("Out of memory\n");
+			return 1;
+		}
+		printf("HLE: %d routines found in the ROM\n", invaders_hle(&hooks, m.memory));
+		m.hle = &hooks;
 	}
 
-	struct i8080 cpu;
-	memset(&cpu, 0, sizeof(struct i8080));
-	uint8_t credit = 1, p1start = 1, p2start = 1;
-	cpu.input_ports[0] = 0b00001110; // bits 1-3 should be always set
-	cpu.input_ports[1] = 0b00001000; // bit 3 should be always set
-	cpu.input_ports[2] = 0b00000000;
-
-	cpu.input_ports[2] |= credit;
-	cpu.input_ports[2] |= p1start << 2;
-	cpu.input_ports[2] |= p2start << 1;
-
-
-	uint8_t* memory = calloc(64000, sizeof(uint8_t));
-	// load executable into memory
-	memcpy(memory, bytecode, sb.st_size);
-
-	// SDL
-	SDL_Init(SDL_INIT_EVERYTHING);
-
-	//const unsigned int texWidth = 256, texHeight = 224;
-	const unsigned int texWidth = 224, texHeight = 256;
-	SDL_Window* window = SDL_CreateWindow(
-		"space invaders emulator",
-		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-		texWidth, texHeight,
-		SDL_WINDOW_SHOWN
-	);
-
-	SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-
-	SDL_RendererInfo info;
-	SDL_GetRendererInfo(renderer, &info);
-	printf("Renderer name: %s\n", info.name);
-	/*
-	printf("Texture formats:\n");
-	for(int i = 0;i < info.num_texture_formats;i ++) {
-		printf("%s\n", SDL_GetPixelFormatName(info.texture_formats[i]));
+	if(wav && audio_wav(&m.audio, wav) != 0) {
+		printf("Failed to create %s\n", wav);
+		return 1;
 	}
-	*/
-
-	SDL_Texture* texture = SDL_CreateTexture(
-		renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
-		texWidth, texHeight
-	);
-
-	clock_t begin = clock();
-	clock_t last_screen_interrupt = begin;
-	uint8_t screen_interrupt_parity = 0;
-	uint8_t debug = 0;
-	while(getFlag(&cpu, HLT) == 0) {
-		SDL_Event event;
-		while(SDL_PollEvent(&event)) {
-			switch(event.type) {
-				case SDL_KEYDOWN:
-					debug = !debug;
-					printf("Key press detected: %d\n", event.key.keysym.scancode);
-					break;
-
-				case SDL_KEYUP:
-					printf("Key release detected: %d\n", event.key.keysym.scancode);
-					break;
-				case SDL_WINDOWEVENT:
-					if(event.window.event == SDL_WINDOWEVENT_CLOSE) {
-						return 0;
-					}
-					break;
-				default: break;
-			}
-		}
 
-		execute_instruction(&cpu, memory, out);
-		if(debug) {
+	if(capture) {
+		const size_t len = strlen(capture);
+		const int y4m = len > 4 && strcmp(capture + len - 4, ".y4m") == 0;
+		m.capture = capture_open(capture, y4m ? CAPTURE_Y4M : CAPTURE_RAW, FPS);
+		if(m.capture == NULL) {
+			printf("Failed to create %s\n", capture);
+			return 1;
 		}
+	}
 
-		if(cpu.instr % 1000 != 0) continue;
-
-		clock_t now = clock();
-		if(now - last_screen_interrupt > 1.0/60/2 * CLOCKS_PER_SEC) {
-			last_screen_interrupt = now;
-			screen_interrupt_parity ++;
-			if(screen_interrupt_parity == 2) {
-				request_interrupt(&cpu, memory, 2);
-				screen_interrupt_parity = 0;
+	if(backend->open(&options) != 0) {
+		printf("Failed to open the %s backend\n", backend->name);
+		return 1;
+	}
 
-				SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
-				SDL_RenderClear(renderer);
+	// without anywhere for the sound to go it isn't made at all
+	if(wav || backend->play(&m.audio) == 0) m.io.audio = &m.audio;
+
+	// fast forward shows frames no faster than the display can
+	const int refresh = backend->refresh();
+	m.refresh_ns = 1000000000ULL / (refresh > 0 ? refresh : FPS);
+	atomic_store(&m.turbo, turbo);
+
+	pthread_t emulator;
+	pthread_create(&emulator, NULL, machine_run, &m);
+
+	// this thread only handles input and shows whatever frame is newest.
+	// The emulator picks the buttons up at its own frame boundary.
+	struct input input = {0};
+	uint32_t shown = 0;
+	while(backend->present && atomic_load(&m.running)) {
+		backend->poll(&input);
+		atomic_store(&m.buttons, input.buttons);
+		if(input.turbo & 1) atomic_fetch_xor(&m.turbo, 1);
+		input.turbo = 0;
+		if(input.quit) atomic_store(&m.running, 0);
+
+		struct frame *frame = triple_latest(&m.frames);
+		if(frame == NULL) {
+			usleep(1000);
+			continue;
+		}
 
-				uint8_t* lockedPixels;
-				int pitch = 0;
-				SDL_LockTexture(texture, NULL, (void **) &lockedPixels, &pitch);
-				drawFBToSDL(memory + 0x2400, lockedPixels);
+		// the dirty columns only cover the changes since the frame before
+		if(frame->seq != shown + 1) memset(frame->dirty, 1, FB_WIDTH);
+		shown = frame->seq;
+		backend->present(frame);
+	}
+	pthread_join(emulator, NULL);
 
-				SDL_UnlockTexture(texture);
-				SDL_RenderCopy(renderer, texture, NULL, NULL);
-				SDL_RenderPresent(renderer);
-			}
-		}
+	audio_close(&m.audio);
+	if(m.capture) capture_close(m.capture);
+	if(m.io.audio) {
+		printf("Audio: %llu underruns, %llu samples dropped\n",
+				(unsigned long long)m.audio.underruns, (unsigned long long)m.audio.dropped);
 	}
 
-	free(memory);
-	//SDL_Delay(10000);
+	if(m.hle) {
+		printf("HLE: %llu calls", (unsigned long long)hooks.calls);
+		if(hooks.check) printf(", %llu differed from the interpreter", (unsigned long long)hooks.mismatches);
+		printf("\n");
+		hle_free(&hooks);
+	}
 
-	SDL_DestroyWindow(window);
-    SDL_Quit();
+	if(m.blocks) blocks_destroy(m.blocks);
+	machine_free(&m);
+	backend->close();
+	return 0;
 }
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> // strcasecmp
+#include <libgen.h> // basename
+#include <pthread.h>
+#include <time.h> // clock_gettime
+#include <unistd.h> // getopt
+
+#include "8080.h"
+#include "cpm.h"
+#include "block.h"
+#include "mem.h"
+
+// Runs a set of CP/M CPU test programs, each one on its own thread, and
+// tells which of them passed. The programs are not part of the repo, put them
+// next to the binary or pass their paths on the command line.
+
+struct rom {
+	const char *name; // file name, case doesn't matter
+	const char *pass; // printed when all tests went fine
+	const char *fail; // printed when something went wrong, NULL if there is no such message
+	uint64_t cycle_limit; // a bit more than the program needs on a correct CPU
+};
+
+static int use_blocks; // -b
+
+static const struct rom known[] = {
+	{"cpudiag_orig.bin", "CPU IS OPERATIONAL", "CPU HAS FAILED", 10000000ULL},
+	{"TST8080.COM", "CPU IS OPERATIONAL", "CPU HAS FAILED", 10000000ULL},
+	{"8080PRE.COM", "8080 Preliminary tests complete", NULL, 10000000ULL},
+	{"CPUTEST.COM", "CPU TESTS OK", NULL, 1000000000ULL},
+	{"8080EXM.COM", "Tests complete", "ERROR", 30000000000ULL},
+};
+#define KNOWN_COUNT (sizeof(known) / sizeof(known[0]))
+
+// anything else has to exit cleanly within this many cycles
+static const struct rom unknown = {NULL, NULL, NULL, 10000000000ULL};
+
+struct job {
+	const char *path;
+	struct rom rom;
+
+	pthread_t thread;
+	int status;
+	const char *verdict;
+	uint64_t cycles;
+	double wall;
+	char *output;
+};
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char *judge(const struct job *job) {
+	const char *out = job->output ? job->output : "";
+	if(job->status == CPM_TIMEOUT) return "FAIL (cycle limit)";
+	if(job->rom.fail && strstr(out, job->rom.fail)) return "FAIL";
+	if(job->status == CPM_HALTED) return "FAIL (halted)";
+	if(job->status == CPM_BAD_CALL) return "FAIL (bad BDOS call)";
+	if(job->rom.pass && !strstr(out, job->rom.pass)) return "FAIL (no pass message)";
+	return "PASS";
+}
+
+static void *run_job(void *arg) {
+	struct job *job = arg;
+
+	uint8_t *memory = mem_create();
+	if(memory == NULL) {
+		job->verdict = "SKIP (out of memory)";
+		return NULL;
+	}
+	const ssize_t size = mem_load(memory, job->path, CPM_TPA, 1);
+	if(size < 0 || size > CPM_MAX_COM) {
+		job->verdict = size < 0 ? "SKIP (can't load)" : "SKIP (too big)";
+		mem_destroy(memory);
+		return NULL;
+	}
+	cpm_setup(memory);
+
+	struct i8080 cpu;
+	memset(&cpu, 0, sizeof(struct i8080));
+
+	struct cpm cpm;
+	cpm_init(&cpm, &cpu, memory, -1);
+	cpm.cycle_limit = job->rom.cycle_limit;
+	if(use_blocks) cpm.blocks = blocks_create();
+
+	const double start = now();
+	job->status = cpm_run(&cpm, &cpu, memory);
+	job->wall = now() - start;
+
+	job->cycles = cpu.clock_cnt;
+	job->output = cpm.capture;
+	job->verdict = judge(job);
+	if(cpm.blocks) blocks_destroy(cpm.blocks);
+
+	mem_destroy(memory);
+	return NULL;
+}
+
+static const struct rom *lookup_rom(const char *path) {
+	char *copy = strdup(path);
+	const char *name = basename(copy);
+
+	const struct rom *found = &unknown;
+	for(size_t i = 0;i < KNOWN_COUNT;i ++) {
+		if(strcasecmp(name, known[i].name) == 0) found = &known[i];
+	}
+
+	free(copy);
+	return found;
+}
+
+int main(int argc, char** argv) {
+	uint64_t cycle_limit = 0;
+	int verbose = 0;
+
+	int opt;
+	while((opt = getopt(argc, argv, "c:vb")) != -1) {
+		switch(opt) {
+			case 'c': cycle_limit = strtoull(optarg, NULL, 0); break;
+			case 'v': verbose = 1; break;
+			case 'b': use_blocks = 1; break;
+			default:
+				printf("Usage: %s [-v] [-b] [-c cycle limit] [COM files]\n", argv[0]);
+				printf("Without files, runs the known test programs found in the current directory\n");
+				return 1;
+		}
+	}
+
+	int count = argc - optind;
+	struct job *jobs;
+	if(count > 0) {
+		jobs = calloc(count, sizeof(struct job));
+		for(int i = 0;i < count;i ++) {
+			jobs[i].path = argv[optind + i];
+			jobs[i].rom = *lookup_rom(jobs[i].path);
+		}
+	} else {
+		count = 0;
+		jobs = calloc(KNOWN_COUNT, sizeof(struct job));
+		for(size_t i = 0;i < KNOWN_COUNT;i ++) {
+			if(access(known[i].name, R_OK) != 0) continue;
+			jobs[count].path = known[i].name;
+			jobs[count].rom = known[i];
+			count ++;
+		}
+	}
+
+	if(count == 0) {
+		printf("No test programs found\n");
+		return 1;
+	}
+
+	const double start = now();
+	for(int i = 0;i < count;i ++) {
+		if(cycle_limit) jobs[i].rom.cycle_limit = cycle_limit;
+		pthread_create(&jobs[i].thread, NULL, run_job, &jobs[i]);
+	}
+
+	int failed = 0;
+	printf("%-20s %-24s %16s %10s %10s\n", "program", "result", "cycles", "seconds", "MHz");
+	for(int i = 0;i < count;i ++) {
+		struct job *job = &jobs[i];
+		pthread_join(job->thread, NULL);
+
+		if(strncmp(job->verdict, "PASS", 4) != 0) failed ++;
+
+		printf("%-20s %-24s %16llu %10.3f %10.1f\n",
+				job->path, job->verdict, (unsigned long long)job->cycles, job->wall,
+				job->wall > 0 ? job->cycles / job->wall / 1e6 : 0);
+
+		if(job->output && job->output[0] && (verbose || strncmp(job->verdict, "FAIL", 4) == 0)) {
+			printf("---- output of %s ----\n%s\n----\n", job->path, job->output);
+		}
+		free(job->output);
+	}
+	printf("%d of %d passed in %.3f seconds\n", count - failed, count, now() - start);
+
+	free(jobs);
+	return failed != 0;
+}
@@ -0,0 +1,26 @@
+#include <string.h> // memset
+
+#include "triple.h"
+
+#define TRIPLE_FRESH 4 // middle holds a frame the reader hasn't seen
+
+void triple_init(struct triple *t) {
+	memset(t->slot, 0, sizeof(t->slot));
+	t->back = 0;
+	atomic_init(&t->middle, 1);
+	t->front = 2;
+}
+
+struct frame *triple_back(struct triple *t) {
+	return &t->slot[t->back];
+}
+
+void triple_publish(struct triple *t) {
+	t->back = atomic_exchange(&t->middle, t->back | TRIPLE_FRESH) & 3;
+}
+
+struct frame *triple_latest(struct triple *t) {
+	if((atomic_load(&t->middle) & TRIPLE_FRESH) == 0) return NULL;
+	t->front = atomic_exchange(&t->middle, t->front) & 3;
+	return &t->slot[t->front];
+}
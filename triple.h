@@ -0,0 +1,33 @@
+#include <stdint.h> // uint8_t, uint32_t
+#include <stdatomic.h>
+
+#include "fb.h"
+
+// Lock free triple buffer that hands finished frames from the emulation
+// thread to the render thread. The writer always has a slot of its own to
+// fill and the reader always has one to draw from, neither ever waits.
+// If the writer is faster, the frames in between are simply replaced.
+
+struct frame {
+	uint32_t seq; // 1 for the first published frame, then +1 each time
+	uint8_t dirty[FB_WIDTH]; // columns that changed since frame seq - 1
+	uint8_t vram[FB_BYTES];
+};
+
+struct triple {
+	struct frame slot[3];
+	atomic_uint middle; // slot that is neither being written nor read, plus TRIPLE_FRESH
+	unsigned back, front; // owned by the writer and the reader
+};
+
+void triple_init(struct triple *t);
+
+// the slot the writer fills in
+struct frame *triple_back(struct triple *t);
+
+// hand the back slot over, the writer gets a different one to fill
+void triple_publish(struct triple *t);
+
+// the newest published frame, or NULL if nothing was published since the
+// last call. It stays valid until the next call.
+struct frame *triple_latest(struct triple *t);